@@ -3,6 +3,7 @@
 
 #include "HouseEditor/BaseCornice.h"
 
+#include "HouseEditor/HouseEditorFunctionLibrary.h"
 #include "Components/StaticMeshComponent.h"
 
 ABaseCornice::ABaseCornice()
@@ -13,36 +14,23 @@ ABaseCornice::ABaseCornice()
 void ABaseCornice::OnConstruction(const FTransform& _transform) {
 	Super::OnConstruction(_transform);
 
-	while (allCornice.Num() > 0) {
-		allCornice.Pop()->DestroyComponent();
-	}
+	const TArray<FHouseMeshPlacement> placements = GetPlacements(corniceLength);
+	UHouseEditorFunctionLibrary::ApplyPlacements(this, placements, allCornice, TEXT("Cornice"));
+}
 
-	FName compName;
-	UStaticMeshComponent* newComp;
-	for (int i = 1; i < corniceLength - 1; i++) {
-		compName = *FString::Printf(TEXT("CorniceBase_%i"), i);
-		newComp = NewObject<UStaticMeshComponent>(this, UStaticMeshComponent::StaticClass(), compName);
-		newComp->CreationMethod = EComponentCreationMethod::UserConstructionScript;
-		newComp->SetupAttachment(RootComponent);
-		newComp->SetRelativeLocation(FVector(segmentWidthInUnits * i, 0, 0));
-		newComp->RegisterComponent();
-		newComp->SetStaticMesh(corniceBase);
-		allCornice.Add(newComp);
+TArray<FHouseMeshPlacement> ABaseCornice::GetPlacements(int Length) const {
+	TArray<FHouseMeshPlacement> placements;
+	const auto addPlacement = [this, &placements](UStaticMesh* mesh, float offset) {
+		FHouseMeshPlacement& placement = placements.AddDefaulted_GetRef();
+		placement.Mesh = mesh;
+		placement.Transform.SetLocation(FVector(segmentWidthInUnits * offset, 0, 0));
+		placement.SourceClass = GetClass();
+	};
+
+	for (int i = 1; i < Length - 1; i++) {
+		addPlacement(corniceBase, i);
 	}
-
-	newComp = NewObject<UStaticMeshComponent>(this, UStaticMeshComponent::StaticClass(), FName("CorniceLeft"));
-	newComp->CreationMethod = EComponentCreationMethod::UserConstructionScript;
-	newComp->SetupAttachment(RootComponent);
-	newComp->SetRelativeLocation(FVector(0, 0, 0));
-	newComp->RegisterComponent();
-	newComp->SetStaticMesh(corniceLeft);
-	allCornice.Add(newComp);
-
-	newComp = NewObject<UStaticMeshComponent>(this, UStaticMeshComponent::StaticClass(), FName("CorniceRight"));
-	newComp->CreationMethod = EComponentCreationMethod::UserConstructionScript;
-	newComp->SetupAttachment(RootComponent);
-	newComp->SetRelativeLocation(FVector(segmentWidthInUnits * (corniceLength - 1), 0, 0));
-	newComp->RegisterComponent();
-	newComp->SetStaticMesh(corniceRight);
-	allCornice.Add(newComp);
+	addPlacement(corniceLeft, 0);
+	addPlacement(corniceRight, Length - 1);
+	return placements;
 }
\ No newline at end of file
@@ -3,6 +3,7 @@
 
 #include "HouseEditor/BaseFireLadder.h"
 
+#include "HouseEditor/HouseEditorFunctionLibrary.h"
 #include "Components/StaticMeshComponent.h"
 
 ABaseFireLadder::ABaseFireLadder()
@@ -14,39 +15,24 @@ ABaseFireLadder::ABaseFireLadder()
 void ABaseFireLadder::OnConstruction(const FTransform& _transform) {
 	Super::OnConstruction(_transform);
 
-	while (allStairs.Num() > 0) {
-		allStairs.Pop()->DestroyComponent();
-	}
+	// Ladder base sits at the root, so stairs and floors are placed in actor space
+	const TArray<FHouseMeshPlacement> placements = GetPlacements(ladderHeight);
+	UHouseEditorFunctionLibrary::ApplyPlacements(this, placements, allStairs, TEXT("Ladder"));
+}
 
-	// UInstancedStaticMeshComponent ??? for the later
-
-	UStaticMeshComponent* ladderBase = NewObject<UStaticMeshComponent>(this, UStaticMeshComponent::StaticClass(), FName("LadderBase"));
-	ladderBase->CreationMethod = EComponentCreationMethod::UserConstructionScript;
-	ladderBase->SetupAttachment(RootComponent);
-	ladderBase->SetRelativeLocation(FVector(0, 0, 0));
-	ladderBase->RegisterComponent();
-	ladderBase->SetStaticMesh(baseMesh);
-	allStairs.Add(ladderBase);
-
-	FName compName;
-	UStaticMeshComponent* newComp;
-	for (int i = 1; i < ladderHeight; i++) {
-		compName = *FString::Printf(TEXT("Stairs_%i"), i);
-		newComp = NewObject<UStaticMeshComponent>(this, UStaticMeshComponent::StaticClass(), compName);
-		newComp->CreationMethod = EComponentCreationMethod::UserConstructionScript;
-		newComp->SetupAttachment(ladderBase);
-		newComp->SetRelativeLocation(FVector(0, 0, segmentHeightInUnits * (i - 1)));
-		newComp->RegisterComponent();
-		newComp->SetStaticMesh(stairsMesh);
-		allStairs.Add(newComp);
-
-		compName = *FString::Printf(TEXT("Floor_%i"), i);
-		newComp = NewObject<UStaticMeshComponent>(this, UStaticMeshComponent::StaticClass(), compName);
-		newComp->CreationMethod = EComponentCreationMethod::UserConstructionScript;
-		newComp->SetupAttachment(ladderBase);
-		newComp->SetRelativeLocation(FVector(0, 0, segmentHeightInUnits * i));
-		newComp->RegisterComponent();
-		newComp->SetStaticMesh(floorMesh);
-		allStairs.Add(newComp);
+TArray<FHouseMeshPlacement> ABaseFireLadder::GetPlacements(int Height) const {
+	TArray<FHouseMeshPlacement> placements;
+	const auto addPlacement = [this, &placements](UStaticMesh* mesh, float height) {
+		FHouseMeshPlacement& placement = placements.AddDefaulted_GetRef();
+		placement.Mesh = mesh;
+		placement.Transform.SetLocation(FVector(0, 0, height));
+		placement.SourceClass = GetClass();
+	};
+
+	addPlacement(baseMesh, 0);
+	for (int i = 1; i < Height; i++) {
+		addPlacement(stairsMesh, segmentHeightInUnits * (i - 1));
+		addPlacement(floorMesh, segmentHeightInUnits * i);
 	}
+	return placements;
 }
\ No newline at end of file
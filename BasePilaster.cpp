@@ -3,6 +3,7 @@
 
 #include "HouseEditor/BasePilaster.h"
 
+#include "HouseEditor/HouseEditorFunctionLibrary.h"
 #include "Components/StaticMeshComponent.h"
 
 // Sets default values
@@ -15,27 +16,17 @@ ABasePilaster::ABasePilaster()
 void ABasePilaster::OnConstruction(const FTransform& _transform) {
 	Super::OnConstruction(_transform);
 
-	while (allPilasters.Num() > 0) {
-		allPilasters.Pop()->DestroyComponent();
-	}
+	const TArray<FHouseMeshPlacement> placements = GetPlacements(pilasterHeight, corniceOffset);
+	UHouseEditorFunctionLibrary::ApplyPlacements(this, placements, allPilasters, TEXT("PilasterSegment"));
+}
 
-	UStaticMeshComponent* newComp;
-	newComp = NewObject<UStaticMeshComponent>(this, UStaticMeshComponent::StaticClass(), FName("PilasterSegment_0"));
-	newComp->CreationMethod = EComponentCreationMethod::UserConstructionScript;
-	newComp->SetupAttachment(RootComponent);
-	newComp->SetRelativeLocation(FVector(0));
-	newComp->RegisterComponent();
-	newComp->SetStaticMesh(pilasterMesh);
-	allPilasters.Add(newComp);
-
-	for (int i = 1; i < pilasterHeight; i++) {
-		FName compName = *FString::Printf(TEXT("PilasterSegment_%i"), i);
-		newComp = NewObject<UStaticMeshComponent>(this, UStaticMeshComponent::StaticClass(), compName);
-		newComp->CreationMethod = EComponentCreationMethod::UserConstructionScript;
-		newComp->SetupAttachment(RootComponent);
-		newComp->SetRelativeLocation(FVector(0, 0, segmentHeightInUnits * i + corniceOffset));
-		newComp->RegisterComponent();
-		newComp->SetStaticMesh(pilasterMesh);
-		allPilasters.Add(newComp);
+TArray<FHouseMeshPlacement> ABasePilaster::GetPlacements(int Height, float CorniceOffset) const {
+	TArray<FHouseMeshPlacement> placements;
+	for (int i = 0; i < FMath::Max(Height, 1); i++) {
+		FHouseMeshPlacement& placement = placements.AddDefaulted_GetRef();
+		placement.Mesh = pilasterMesh;
+		placement.Transform.SetLocation(i == 0 ? FVector(0) : FVector(0, 0, segmentHeightInUnits * i + CorniceOffset));
+		placement.SourceClass = GetClass();
 	}
+	return placements;
 }
\ No newline at end of file
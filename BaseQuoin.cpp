@@ -3,6 +3,7 @@
 
 #include "HouseEditor/BaseQuoin.h"
 
+#include "HouseEditor/HouseEditorFunctionLibrary.h"
 #include "Components/StaticMeshComponent.h"
 
 // Sets default values
@@ -15,27 +16,17 @@ ABaseQuoin::ABaseQuoin()
 void ABaseQuoin::OnConstruction(const FTransform& _transform) {
 	Super::OnConstruction(_transform);
 
-	while (allQuoins.Num() > 0) {
-		allQuoins.Pop()->DestroyComponent();
-	}
+	const TArray<FHouseMeshPlacement> placements = GetPlacements(quoinHeight, corniceOffset);
+	UHouseEditorFunctionLibrary::ApplyPlacements(this, placements, allQuoins, TEXT("QuoinSegment"));
+}
 
-	UStaticMeshComponent* newComp;
-	newComp = NewObject<UStaticMeshComponent>(this, UStaticMeshComponent::StaticClass(), FName("QuoinSegment_0"));
-	newComp->CreationMethod = EComponentCreationMethod::UserConstructionScript;
-	newComp->SetupAttachment(RootComponent);
-	newComp->SetRelativeLocation(FVector(0));
-	newComp->RegisterComponent();
-	newComp->SetStaticMesh(quoinMesh);
-	allQuoins.Add(newComp);
-
-	for (int i = 1; i < quoinHeight; i++) {
-		FName compName = *FString::Printf(TEXT("QuoinSegment_%i"), i);
-		newComp = NewObject<UStaticMeshComponent>(this, UStaticMeshComponent::StaticClass(), compName);
-		newComp->CreationMethod = EComponentCreationMethod::UserConstructionScript;
-		newComp->SetupAttachment(RootComponent);
-		newComp->SetRelativeLocation(FVector(0, 0, segmentHeightInUnits * i + corniceOffset));
-		newComp->RegisterComponent();
-		newComp->SetStaticMesh(quoinMesh);
-		allQuoins.Add(newComp);
+TArray<FHouseMeshPlacement> ABaseQuoin::GetPlacements(int Height, float CorniceOffset) const {
+	TArray<FHouseMeshPlacement> placements;
+	for (int i = 0; i < FMath::Max(Height, 1); i++) {
+		FHouseMeshPlacement& placement = placements.AddDefaulted_GetRef();
+		placement.Mesh = quoinMesh;
+		placement.Transform.SetLocation(i == 0 ? FVector(0) : FVector(0, 0, segmentHeightInUnits * i + CorniceOffset));
+		placement.SourceClass = GetClass();
 	}
+	return placements;
 }
\ No newline at end of file
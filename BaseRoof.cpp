@@ -3,6 +3,7 @@
 
 #include "HouseEditor/BaseRoof.h"
 
+#include "HouseEditor/HouseEditorFunctionLibrary.h"
 #include "Components/StaticMeshComponent.h"
 
 ABaseRoof::ABaseRoof()
@@ -13,86 +14,56 @@ ABaseRoof::ABaseRoof()
 void ABaseRoof::OnConstruction(const FTransform& Transform) {
 	Super::OnConstruction(Transform);
 
-	while (AllElements.Num() > 0)
-	{
-		AllElements.Pop()->DestroyComponent();
-	}
 	while (LineAnchors.Num() > 0)
 	{
 		LineAnchors.Pop()->DestroyComponent();
 	}
 
-	// Anchors created manually, while we using "box" houses.
-	for (int Index = 0; Index < 4; Index++)
+	const TArray<FHouseMeshPlacement> Placements = GetPlacements(RoofLength, RoofWidth);
+	UHouseEditorFunctionLibrary::ApplyPlacements(this, Placements, AllElements, TEXT("RoofElement"));
+}
+
+TArray<FHouseMeshPlacement> ABaseRoof::GetPlacements(int Length, int Width) const
+{
+	TArray<FHouseMeshPlacement> Placements;
+	const auto AddPlacement = [this, &Placements](UStaticMesh* Mesh, const FTransform& Transform)
 	{
-		FVector CompRelLoc;
-		switch (Index) {
-		case 0:
-			CompRelLoc = FVector(0);
-			break;
-		case 1:
-			CompRelLoc = FVector(SegmentWidthInUnits * RoofLength, 0, 0);
-			break;
-		case 2:
-			CompRelLoc = FVector(SegmentWidthInUnits * RoofLength, SegmentWidthInUnits * -RoofWidth, 0);
-			break;
-		case 3:
-			CompRelLoc = FVector(0, SegmentWidthInUnits * -RoofWidth, 0);
-			break;
-		default:
-			break;
-		}
-		
-		FName CompName = *FString::Printf(TEXT("RoofAnchor_%i"), Index);
-		USceneComponent* NewComp = NewObject<USceneComponent>(this, USceneComponent::StaticClass(), CompName);
-		NewComp->CreationMethod = EComponentCreationMethod::UserConstructionScript;
-		NewComp->SetupAttachment(RootComponent);
-		NewComp->SetRelativeLocationAndRotation(CompRelLoc, FRotator(0, Index * -90, 0));
-		NewComp->RegisterComponent();
-		LineAnchors.Add(NewComp);
-	}
+		FHouseMeshPlacement& Placement = Placements.AddDefaulted_GetRef();
+		Placement.Mesh = Mesh;
+		Placement.Transform = Transform;
+		Placement.SourceClass = GetClass();
+	};
+
+	// Line anchors, while we using "box" houses
+	const FVector AnchorLocations[4] = {
+		FVector(0),
+		FVector(SegmentWidthInUnits * Length, 0, 0),
+		FVector(SegmentWidthInUnits * Length, SegmentWidthInUnits * -Width, 0),
+		FVector(0, SegmentWidthInUnits * -Width, 0)
+	};
 
 	// Outer elements
-	for (int SideIndex = 0; SideIndex < RoofLines.Num(); SideIndex++)
+	for (int SideIndex = 0; SideIndex < FMath::Min(RoofLines.Num(), 4); SideIndex++)
 	{
-		int SideLenght = (SideIndex % 2 == 0) ? RoofLength : RoofWidth;		// Temp one, cause using "box" houses
-		FName SMCompName = *FString::Printf(TEXT("Corner_%i"), SideIndex);
-		UStaticMeshComponent* NewSMComp = NewObject<UStaticMeshComponent>(this, UStaticMeshComponent::StaticClass(), SMCompName);
-		NewSMComp->CreationMethod = EComponentCreationMethod::UserConstructionScript;
-		NewSMComp->SetupAttachment(LineAnchors[SideIndex]);
-		NewSMComp->RegisterComponent();
-		NewSMComp->SetStaticMesh(GetMesh(SideIndex, -1));
-		AllElements.Add(NewSMComp);
-		
+		const FTransform AnchorTransform(FRotator(0, SideIndex * -90, 0), AnchorLocations[SideIndex]);
+		int SideLenght = (SideIndex % 2 == 0) ? Length : Width;		// Temp one, cause using "box" houses
+		AddPlacement(GetMesh(SideIndex, -1), AnchorTransform);
+
 		for (int ElemIndex = 0; ElemIndex < SideLenght - 2; ElemIndex++)
 		{
-			SMCompName = *FString::Printf(TEXT("SideElement_%i_%i"), SideIndex, ElemIndex);
-			NewSMComp = NewObject<UStaticMeshComponent>(this, UStaticMeshComponent::StaticClass(), SMCompName);
-			NewSMComp->CreationMethod = EComponentCreationMethod::UserConstructionScript;
-			NewSMComp->SetupAttachment(LineAnchors[SideIndex]);
-			NewSMComp->SetRelativeLocation(FVector(SegmentWidthInUnits * (ElemIndex + 1), 0, 0));
-			NewSMComp->RegisterComponent();
-			NewSMComp->SetStaticMesh(GetMesh(SideIndex, ElemIndex));
-			AllElements.Add(NewSMComp);
+			AddPlacement(GetMesh(SideIndex, ElemIndex), FTransform(FVector(SegmentWidthInUnits * (ElemIndex + 1), 0, 0)) * AnchorTransform);
 		}
 	}
 
 	// Inner elements (filler)
-	for (int HIndex = 1; HIndex < RoofLength - 1; HIndex++)
+	for (int HIndex = 1; HIndex < Length - 1; HIndex++)
 	{
-		for (int VIndex = 1; VIndex < RoofWidth -1; VIndex++)
+		for (int VIndex = 1; VIndex < Width - 1; VIndex++)
 		{
-			FName FillerCompName = *FString::Printf(TEXT("FillerElement_%i_%i"), HIndex, VIndex);
-			UStaticMeshComponent* FillerComp = NewObject<UStaticMeshComponent>(this, UStaticMeshComponent::StaticClass(), FillerCompName);
-			FillerComp->CreationMethod = EComponentCreationMethod::UserConstructionScript;
-			FillerComp->SetupAttachment(RootComponent);
-			FillerComp->SetRelativeLocation(FVector(SegmentWidthInUnits * HIndex, SegmentWidthInUnits * -VIndex, FillerHeightOffset));
-			FillerComp->RegisterComponent();
-			FillerComp->SetStaticMesh(FillerMesh);
-			AllElements.Add(FillerComp);
+			AddPlacement(FillerMesh, FTransform(FVector(SegmentWidthInUnits * HIndex, SegmentWidthInUnits * -VIndex, FillerHeightOffset)));
 		}
 	}
-
+	return Placements;
 }
 
 void ABaseRoof::SetMaterialByName(TEnumAsByte<EMaterialSlot> SlotName, UMaterialInterface* Material)
@@ -124,7 +95,7 @@ void ABaseRoof::SetMaterialByName(TEnumAsByte<EMaterialSlot> SlotName, UMaterial
 	}
 }
 
-UStaticMesh* ABaseRoof::GetMesh(int SideIndex, int ElemIndex)
+UStaticMesh* ABaseRoof::GetMesh(int SideIndex, int ElemIndex) const
 {
 	if (RoofLines.IsValidIndex(SideIndex) == false)
 	{
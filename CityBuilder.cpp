@@ -5,6 +5,7 @@
 
 #include "AssetRegistry/AssetRegistryModule.h"
 #include "PP_EDGE/EDGESettings.h"
+#include "HouseEditor/HouseBuildScheduler.h"
 
 
 ACityBuilderActor::ACityBuilderActor()
@@ -84,9 +85,21 @@ void ACityBuilderActor::BuildCity()
 		}
 	}
 
+	// Items of a game world are built in turn, nearest first
+	UHouseBuildScheduler* Scheduler = UHouseBuildScheduler::Get(this);
 	for (auto& Item : AllActors)
 	{
-		ICityItem::Execute_BuildCityItem(Item);
+		if (Scheduler != nullptr)
+		{
+			Scheduler->QueueTask(Item, EHouseBuildTaskType::Custom, [Item]()
+			{
+				ICityItem::Execute_BuildCityItem(Item);
+			});
+		}
+		else
+		{
+			ICityItem::Execute_BuildCityItem(Item);
+		}
 	}
 	
 }
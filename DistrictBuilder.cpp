@@ -5,6 +5,7 @@
 
 #include "AssetRegistry/AssetRegistryModule.h"
 #include "PP_EDGE/EDGESettings.h"
+#include "HouseEditor/HouseBuildScheduler.h"
 
 
 ADistrictBuilderActor::ADistrictBuilderActor()
@@ -84,9 +85,21 @@ void ADistrictBuilderActor::BuildDistrict()
 		}
 	}
 
+	// Items of a game world are built in turn, nearest first
+	UHouseBuildScheduler* Scheduler = UHouseBuildScheduler::Get(this);
 	for (auto& Item : AllActors)
 	{
-		IDistrictItem::Execute_BuildDistrictItem(Item);
+		if (Scheduler != nullptr)
+		{
+			Scheduler->QueueTask(Item, EHouseBuildTaskType::Custom, [Item]()
+			{
+				IDistrictItem::Execute_BuildDistrictItem(Item);
+			});
+		}
+		else
+		{
+			IDistrictItem::Execute_BuildDistrictItem(Item);
+		}
 	}
 	
 }
@@ -6,6 +6,9 @@
 
 //#include "../../../../../../../../UE_4.26/Engine/Plugins/Experimental/AlembicImporter/Source/AlembicLibrary/Public/AbcFile.h"
 
+// 1 - initial format, 2 - LOD index added to sections info, 3 - collision boxes added after vertex data
+static const int FileFormatVersion = 3;
+
 
 bool GetDir(const string& FullName, string& DirName)
 {
@@ -37,7 +40,7 @@ bool CheckDir(const string& Dir)
 }
 
 
-bool EDGEMeshDataProvider::WriteToFile(const string& FileName, const vector<EDGEMeshSectionData>& MeshData, string& OutErrorString)
+bool EDGEMeshDataProvider::WriteToFile(const string& FileName, const vector<EDGEMeshSectionData>& MeshData, const vector<float>& CollisionBoxes, string& OutErrorString)
 {
 	string FileDir;
 	if (GetDir(FileName, FileDir))
@@ -57,11 +60,14 @@ bool EDGEMeshDataProvider::WriteToFile(const string& FileName, const vector<EDGE
 		return false;
 	}
 
+	// File format version goes first, so older files can still be read
+	OutFile << "v" << FileFormatVersion;
+
 	// Get amount of sections in mesh
 	const int SectionsCount = MeshData.size();
-	OutFile << SectionsCount;
+	OutFile << " " << SectionsCount;
 
-	// Write sections info: min/max indices, used material slot
+	// Write sections info: min/max indices, LOD index, used material slot
 	for (auto& Section : MeshData)
 	{
 		WriteVector(OutFile, Section.SectionData);
@@ -78,12 +84,16 @@ bool EDGEMeshDataProvider::WriteToFile(const string& FileName, const vector<EDGE
 		WriteVector(OutFile, Section.Indices);
 	}
 
+	// Collision boxes as min and max points
+	OutFile << " " << CollisionBoxes.size() / 6;
+	WriteVector(OutFile, CollisionBoxes);
+
 	OutFile.close();
 
 	return true;
 }
 
-bool EDGEMeshDataProvider::ReadFromFile(const string& FileName, vector<EDGEMeshSectionData>& OutMeshData, string& OutErrorString)
+bool EDGEMeshDataProvider::ReadFromFile(const string& FileName, vector<EDGEMeshSectionData>& OutMeshData, vector<float>& OutCollisionBoxes, string& OutErrorString)
 {
 	ifstream InFile(FileName);
 
@@ -109,19 +119,39 @@ bool EDGEMeshDataProvider::ReadFromFile(const string& FileName, vector<EDGEMeshS
 		prevPtr = nxtPtr + 1;
 	};
 
-	// Get number of Sections
+	// Files without version tag were written before LODs support (version 1)
+	int Version = 1;
 	GetPart(InStr);
+	if (!InStr.empty() && InStr[0] == 'v')
+	{
+		Version = stoi(InStr.substr(1));
+		GetPart(InStr);
+	}
+	if (Version > FileFormatVersion)
+	{
+		OutErrorString = "File <" + FileName + "> was written by newer version of mesh data provider.";
+		return false;
+	}
+
+	// Get number of Sections
 	const int SectionsCount = stoi(InStr);
 
+	// Version 1 has no LOD index in sections info
+	const int SectionInfoCount = (Version >= 2) ? 5 : 4;
+
 	// Get Sections info
 	for (int SectionIdx = 0; SectionIdx < SectionsCount; SectionIdx++)
 	{
 		OutMeshData.push_back(EDGEMeshSectionData());
-		for (int nIdx = 0; nIdx < 4; nIdx++)
+		for (int nIdx = 0; nIdx < SectionInfoCount; nIdx++)
 		{
 			GetPart(InStr);
 			OutMeshData[SectionIdx].SectionData.push_back(stoi(InStr));
 		}
+		if (SectionInfoCount < 5)
+		{
+			OutMeshData[SectionIdx].SectionData.push_back(0);		// LODIndex
+		}
 		GetPart(OutMeshData[SectionIdx].MaterialName);
 	}
 
@@ -171,6 +201,18 @@ bool EDGEMeshDataProvider::ReadFromFile(const string& FileName, vector<EDGEMeshS
 			OutMeshData[SectionIdx].Indices.push_back(stoi(InStr));
 		}
 	}
+
+	// Older versions have no collision boxes, bounds are used instead
+	if (Version >= 3)
+	{
+		GetPart(InStr);
+		const int BoxesCount = stoi(InStr);
+		for (int nIdx = 0; nIdx < BoxesCount * 6; nIdx++)
+		{
+			GetPart(InStr);
+			OutCollisionBoxes.push_back(stof(InStr));
+		}
+	}
 	
 	return true;
 }
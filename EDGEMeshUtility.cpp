@@ -5,11 +5,24 @@
 
 #include "EdgeHouseConstructor/EdgeHouseConstructorSettings.h"
 #include "HouseEditor/HouseEditorFunctionLibrary.h"
+#include "HAL/FileManager.h"
+#include "Engine/StaticMesh.h"
+#include "PhysicsEngine/BodySetup.h"
+#include "StaticMeshAttributes.h"
 
-bool UEDGEMeshUtility::ReadMeshDataAsRaw(const UStaticMeshComponent* MeshComp, const FVertexOffsetParams& OffsetParams,  vector<EDGEMeshSectionData>& OutRawData)
+bool UEDGEMeshUtility::ReadMeshDataAsRaw(const UStaticMeshComponent* MeshComp, const FVertexOffsetParams& OffsetParams,  vector<EDGEMeshSectionData>& OutRawData, int NumLODs)
 {
+	TArray<UMaterialInterface*> Materials;
+	for (int MatIdx = 0; MatIdx < MeshComp->GetNumMaterials(); MatIdx++)
+	{
+		Materials.Add(MeshComp->GetMaterial(MatIdx));
+	}
+	return ReadMeshDataAsRaw(MeshComp->GetStaticMesh(), Materials, OffsetParams, OutRawData, NumLODs);
+}
 
-	const auto& Mesh = MeshComp->GetStaticMesh();
+// Materials are per slot overrides, empty ones fall back to the mesh material
+bool UEDGEMeshUtility::ReadMeshDataAsRaw(const UStaticMesh* Mesh, const TArray<UMaterialInterface*>& Materials, const FVertexOffsetParams& OffsetParams,  vector<EDGEMeshSectionData>& OutRawData, int NumLODs)
+{
 	// This will throw assert?
 	check(Mesh != nullptr);
 
@@ -27,34 +40,36 @@ bool UEDGEMeshUtility::ReadMeshDataAsRaw(const UStaticMeshComponent* MeshComp, c
 	bool bDataTableWasUpdated = false;
 	
 	OutRawData.clear();
-	
-	//const int LODCount = Mesh->RenderData->LODResources.Num();			// TODO: Don't forget to implement LODs
-	//for (int LODIdx = 0; LODIdx < LODCount; LODIdx++)
-	const int LODIdx = 0;
+
+	// Every house LOD must contain every element, so meshes with less authored LODs repeat their last one
+	const int MeshLODCount = Mesh->RenderData->LODResources.Num();
+	for (int LODIdx = 0; LODIdx < FMath::Max(NumLODs, 1); LODIdx++)
 	{
-		auto& LOD = Mesh->RenderData->LODResources[LODIdx];
+		auto& LOD = Mesh->RenderData->LODResources[FMath::Min(LODIdx, MeshLODCount - 1)];
 		for (int SectionIdx = 0; SectionIdx < LOD.Sections.Num(); SectionIdx++)
 		{
 			auto& Section = LOD.Sections[SectionIdx];
 			OutRawData.push_back(EDGEMeshSectionData());
+			EDGEMeshSectionData& RawSection = OutRawData.back();
 
 			// Base section info
-			OutRawData[SectionIdx].SectionData.push_back(Section.MinVertexIndex);
-			OutRawData[SectionIdx].SectionData.push_back(Section.MaxVertexIndex);
-			OutRawData[SectionIdx].SectionData.push_back(Section.FirstIndex);
-			OutRawData[SectionIdx].SectionData.push_back(Section.NumTriangles);
+			RawSection.SectionData.push_back(Section.MinVertexIndex);
+			RawSection.SectionData.push_back(Section.MaxVertexIndex);
+			RawSection.SectionData.push_back(Section.FirstIndex);
+			RawSection.SectionData.push_back(Section.NumTriangles);
+			RawSection.SectionData.push_back(LODIdx);
 
 			// Finding material name
-			OutRawData[SectionIdx].MaterialName = "NONE";
+			RawSection.MaterialName = "NONE";
 			bool bMatWasFound = false;
 			if (MaterialsTable != nullptr)
 			{
-				const auto& MatInterface = MeshComp->GetMaterial(Section.MaterialIndex);
+				UMaterialInterface* MatInterface = (Materials.IsValidIndex(Section.MaterialIndex) && Materials[Section.MaterialIndex] != nullptr) ? Materials[Section.MaterialIndex] : Mesh->GetMaterial(Section.MaterialIndex);
 				for (auto& RowRef : MatRows)
 				{
 					if (RowRef->Material == MatInterface)
 					{
-						OutRawData[SectionIdx].MaterialName = string(TCHAR_TO_UTF8(*RowRef->MatName));
+						RawSection.MaterialName = string(TCHAR_TO_UTF8(*RowRef->MatName));
 						bMatWasFound = true;
 					}
 				}
@@ -65,7 +80,8 @@ bool UEDGEMeshUtility::ReadMeshDataAsRaw(const UStaticMeshComponent* MeshComp, c
 					NewRow.MatName = MatInterface->GetName();
 					const FName NewRowName = *FString::Printf(TEXT("%s"), *NewRow.MatName);
 					MaterialsTable->AddRow(NewRowName, NewRow);
-					OutRawData[SectionIdx].MaterialName = string(TCHAR_TO_UTF8(*NewRow.MatName));
+					MatRows.Add(MaterialsTable->FindRow<FMaterialsTableRow>(NewRowName, FString()));
+					RawSection.MaterialName = string(TCHAR_TO_UTF8(*NewRow.MatName));
 					bDataTableWasUpdated = true;
 				}
 			}
@@ -79,33 +95,33 @@ bool UEDGEMeshUtility::ReadMeshDataAsRaw(const UStaticMeshComponent* MeshComp, c
 				Vector = LOD.VertexBuffers.PositionVertexBuffer.VertexPosition(VertIdx);
 				Vector = OffsetParams.MeshRotation.RotateVector(Vector);
 				Vector += OffsetParams.PivotOffset;
-				OutRawData[SectionIdx].Vertices.push_back(Vector.X);
-				OutRawData[SectionIdx].Vertices.push_back(Vector.Y);
-				OutRawData[SectionIdx].Vertices.push_back(Vector.Z);
+				RawSection.Vertices.push_back(Vector.X);
+				RawSection.Vertices.push_back(Vector.Y);
+				RawSection.Vertices.push_back(Vector.Z);
 
 				// Normals
 				Vector = LOD.VertexBuffers.StaticMeshVertexBuffer.VertexTangentZ(VertIdx);
 				Vector = OffsetParams.MeshRotation.RotateVector(Vector);
-				OutRawData[SectionIdx].Normals.push_back(Vector.X);
-				OutRawData[SectionIdx].Normals.push_back(Vector.Y);
-				OutRawData[SectionIdx].Normals.push_back(Vector.Z);
+				RawSection.Normals.push_back(Vector.X);
+				RawSection.Normals.push_back(Vector.Y);
+				RawSection.Normals.push_back(Vector.Z);
 
 				// Tangents
 				Vector = LOD.VertexBuffers.StaticMeshVertexBuffer.VertexTangentX(VertIdx);
 				Vector = OffsetParams.MeshRotation.RotateVector(Vector);
-				OutRawData[SectionIdx].Tangents.push_back(Vector.X);
-				OutRawData[SectionIdx].Tangents.push_back(Vector.Y);
-				OutRawData[SectionIdx].Tangents.push_back(Vector.Z);
+				RawSection.Tangents.push_back(Vector.X);
+				RawSection.Tangents.push_back(Vector.Y);
+				RawSection.Tangents.push_back(Vector.Z);
 
 				// UVs
-				OutRawData[SectionIdx].UVs.push_back(LOD.VertexBuffers.StaticMeshVertexBuffer.GetVertexUV(VertIdx, 0).X);
-				OutRawData[SectionIdx].UVs.push_back(LOD.VertexBuffers.StaticMeshVertexBuffer.GetVertexUV(VertIdx, 0).Y);
+				RawSection.UVs.push_back(LOD.VertexBuffers.StaticMeshVertexBuffer.GetVertexUV(VertIdx, 0).X);
+				RawSection.UVs.push_back(LOD.VertexBuffers.StaticMeshVertexBuffer.GetVertexUV(VertIdx, 0).Y);
 			}
 
 			// Faces indices
 			for (uint32 Idx = Section.FirstIndex; Idx < Section.FirstIndex + Section.NumTriangles * 3; Idx++)
 			{
-				OutRawData[SectionIdx].Indices.push_back(LOD.IndexBuffer.GetIndex(Idx) - Section.MinVertexIndex);
+				RawSection.Indices.push_back(LOD.IndexBuffer.GetIndex(Idx) - Section.MinVertexIndex);
 			}
 		} // End Sections generating
 
@@ -123,7 +139,7 @@ bool UEDGEMeshUtility::ReadMeshDataAsRaw(const UStaticMeshComponent* MeshComp, c
 void UEDGEMeshUtility::MergeSections(vector<EDGEMeshSectionData>& RawData)
 {
 	TArray<int> SectionsThatMoved;
-	TArray<string> MatNames;
+	TArray<string> MatNames;		// Sections are merged per material inside one LOD, so keys are "<LOD>:<Material>"
 	TArray<int> RemappedIndices;
 
 	if (RawData.size() == 0)
@@ -134,8 +150,9 @@ void UEDGEMeshUtility::MergeSections(vector<EDGEMeshSectionData>& RawData)
 	
 	for (int SectionIdx = 0; SectionIdx < RawData.size(); SectionIdx++)
 	{
-		int SectionIdxWithMat = 0;MatNames.Find(RawData[SectionIdx].MaterialName);
-		if (MatNames.Find(RawData[SectionIdx].MaterialName, SectionIdxWithMat))
+		const string MergeKey = to_string(RawData[SectionIdx].SectionData[4]) + ":" + RawData[SectionIdx].MaterialName;
+		int SectionIdxWithMat = 0;
+		if (MatNames.Find(MergeKey, SectionIdxWithMat))
 		{
 			auto& BaseSection = RawData[RemappedIndices[SectionIdxWithMat]];
 			auto& MovedSection = RawData[SectionIdx];
@@ -154,7 +171,7 @@ void UEDGEMeshUtility::MergeSections(vector<EDGEMeshSectionData>& RawData)
 		}
 		else
 		{
-			MatNames.Add(RawData[SectionIdx].MaterialName);
+			MatNames.Add(MergeKey);
 			RemappedIndices.Add(SectionIdx);
 		}
 	}
@@ -180,37 +197,210 @@ void UEDGEMeshUtility::MergeSections(vector<EDGEMeshSectionData>& RawData)
 	}
 }
 
-bool UEDGEMeshUtility::WriteMeshDataToFile(const FString& FileName, const vector<EDGEMeshSectionData>& RawData)
+void UEDGEMeshUtility::AppendBoundsLOD(vector<EDGEMeshSectionData>& RawData, int LODIndex)
+{
+	if (RawData.size() == 0)
+	{
+		return;
+	}
+
+	// Bounds and material of the biggest section are taken from LOD 0
+	FBox Bounds(ForceInit);
+	const EDGEMeshSectionData* MainSection = nullptr;
+	for (const auto& Section : RawData)
+	{
+		if (Section.SectionData[4] != 0)
+		{
+			continue;
+		}
+		for (int Idx = 0; Idx < Section.Vertices.size(); Idx += 3)
+		{
+			Bounds += FVector(Section.Vertices[Idx], Section.Vertices[Idx+1], Section.Vertices[Idx+2]);
+		}
+		if (MainSection == nullptr || MainSection->Indices.size() < Section.Indices.size())
+		{
+			MainSection = &Section;
+		}
+	}
+	if (MainSection == nullptr || !Bounds.IsValid)
+	{
+		return;
+	}
+
+	RawData.push_back(MakeBoxSection(Bounds, MainSection->MaterialName, LODIndex));
+}
+
+// Moves raw data read in some local space to where it belongs, same way ReadMeshDataAsRaw applies its offsets (no scale)
+void UEDGEMeshUtility::TransformRawSections(vector<EDGEMeshSectionData>& RawData, const FTransform& Transform)
 {
-	FString UnrealFullFileName = FPlatformProcess::UserTempDir() + FString("EDGE/SavedMeshData/") + FileName + ".txt";
+	const FQuat Rotation = Transform.GetRotation();
+	const FVector Offset = Transform.GetLocation();
+	for (auto& Section : RawData)
+	{
+		for (int Idx = 0; Idx + 2 < Section.Vertices.size(); Idx += 3)
+		{
+			const FVector Vector = Rotation.RotateVector(FVector(Section.Vertices[Idx], Section.Vertices[Idx+1], Section.Vertices[Idx+2])) + Offset;
+			Section.Vertices[Idx] = Vector.X;
+			Section.Vertices[Idx+1] = Vector.Y;
+			Section.Vertices[Idx+2] = Vector.Z;
+		}
+		for (vector<float>* Directions : { &Section.Normals, &Section.Tangents })
+		{
+			for (int Idx = 0; Idx + 2 < Directions->size(); Idx += 3)
+			{
+				const FVector Vector = Rotation.RotateVector(FVector((*Directions)[Idx], (*Directions)[Idx+1], (*Directions)[Idx+2]));
+				(*Directions)[Idx] = Vector.X;
+				(*Directions)[Idx+1] = Vector.Y;
+				(*Directions)[Idx+2] = Vector.Z;
+			}
+		}
+	}
+}
+
+EDGEMeshSectionData UEDGEMeshUtility::MakeBoxSection(const FBox& Bounds, const string& MaterialName, int LODIndex)
+{
+	EDGEMeshSectionData BoxSection;
+	BoxSection.SectionData = { 0, 0, 0, 0, LODIndex };		// Offsets are recalculated by MergeSections
+	BoxSection.MaterialName = MaterialName;
+
+	const FVector& Min = Bounds.Min;
+	const FVector& Max = Bounds.Max;
+
+	const auto AddQuad = [&BoxSection](const FVector& V0, const FVector& V1, const FVector& V2, const FVector& V3, const FVector& Normal)
+	{
+		const int FirstVert = BoxSection.Vertices.size() / 3;
+		const FVector Tangent = (V1 - V0).GetSafeNormal();
+		const float Width = (V1 - V0).Size();
+		const float Height = (V3 - V0).Size();
+		const FVector2D UVs[4] = { FVector2D(0.f, Height), FVector2D(Width, Height), FVector2D(Width, 0.f), FVector2D(0.f, 0.f) };
+		const FVector Verts[4] = { V0, V1, V2, V3 };
+
+		for (int Idx = 0; Idx < 4; Idx++)
+		{
+			BoxSection.Vertices.insert(end(BoxSection.Vertices), { Verts[Idx].X, Verts[Idx].Y, Verts[Idx].Z });
+			BoxSection.Normals.insert(end(BoxSection.Normals), { Normal.X, Normal.Y, Normal.Z });
+			BoxSection.Tangents.insert(end(BoxSection.Tangents), { Tangent.X, Tangent.Y, Tangent.Z });
+			BoxSection.UVs.insert(end(BoxSection.UVs), { UVs[Idx].X / SegmentWidthInUnits, UVs[Idx].Y / SegmentHeightInUnits });
+		}
+
+		// Keep winding consistent with the face normal
+		const bool bFlip = FVector::DotProduct((V0 - V2) ^ (V1 - V2), Normal) < 0.f;
+		const int Tris[6] = { 0, 1, 2, 0, 2, 3 };
+		for (int Idx = 0; Idx < 6; Idx += 3)
+		{
+			BoxSection.Indices.push_back(FirstVert + Tris[Idx]);
+			BoxSection.Indices.push_back(FirstVert + Tris[bFlip ? Idx + 2 : Idx + 1]);
+			BoxSection.Indices.push_back(FirstVert + Tris[bFlip ? Idx + 1 : Idx + 2]);
+		}
+	};
+
+	// Walls and top, bottom is never visible
+	AddQuad(FVector(Min.X, Max.Y, Min.Z), FVector(Max.X, Max.Y, Min.Z), FVector(Max.X, Max.Y, Max.Z), FVector(Min.X, Max.Y, Max.Z), FVector(0.f, 1.f, 0.f));
+	AddQuad(FVector(Max.X, Max.Y, Min.Z), FVector(Max.X, Min.Y, Min.Z), FVector(Max.X, Min.Y, Max.Z), FVector(Max.X, Max.Y, Max.Z), FVector(1.f, 0.f, 0.f));
+	AddQuad(FVector(Max.X, Min.Y, Min.Z), FVector(Min.X, Min.Y, Min.Z), FVector(Min.X, Min.Y, Max.Z), FVector(Max.X, Min.Y, Max.Z), FVector(0.f, -1.f, 0.f));
+	AddQuad(FVector(Min.X, Min.Y, Min.Z), FVector(Min.X, Max.Y, Min.Z), FVector(Min.X, Max.Y, Max.Z), FVector(Min.X, Min.Y, Max.Z), FVector(-1.f, 0.f, 0.f));
+	AddQuad(FVector(Min.X, Max.Y, Max.Z), FVector(Max.X, Max.Y, Max.Z), FVector(Max.X, Min.Y, Max.Z), FVector(Min.X, Min.Y, Max.Z), FVector(0.f, 0.f, 1.f));
+
+	return BoxSection;
+}
+
+FString UEDGEMeshUtility::GetMeshDataFilePath(const FString& FileName)
+{
+	return FPlatformProcess::UserTempDir() + FString("EDGE/SavedMeshData/") + FileName + ".txt";
+}
+
+// Cooked collision lives next to geometry, so both are dropped together. Collision hash is part of the name, regenerated geometry never finds an old cook.
+FString UEDGEMeshUtility::GetCollisionDataFilePath(const FString& FileName, uint64 CollisionHash)
+{
+	return FPlatformProcess::UserTempDir() + FString("EDGE/SavedMeshData/") + FileName + FString::Printf(TEXT(".%016llx"), CollisionHash) + ".collision";
+}
+
+void UEDGEMeshUtility::RemoveCollisionDataFiles(const FString& FileName)
+{
+	const FString Directory = FPlatformProcess::UserTempDir() + FString("EDGE/SavedMeshData/");
+	TArray<FString> Files;
+	IFileManager::Get().FindFiles(Files, *(Directory + FileName + ".*.collision"), true, false);
+	for (const FString& File : Files)
+	{
+		IFileManager::Get().Delete(*(Directory + File), false, false, true);
+	}
+}
+
+// Written next to the final file and moved over it, so readers on other threads never see half a file
+bool UEDGEMeshUtility::WriteMeshDataToFile(const FString& FileName, const vector<EDGEMeshSectionData>& RawData, const TArray<FBox>& CollisionBoxes)
+{
+	FString TempFilePath;
+	return WriteMeshDataToTempFile(FileName, RawData, CollisionBoxes, TempFilePath) && CommitMeshDataFile(FileName, TempFilePath);
+}
+
+// Unique name, so several writers of one file don't share it. Nothing reads it until CommitMeshDataFile.
+bool UEDGEMeshUtility::WriteMeshDataToTempFile(const FString& FileName, const vector<EDGEMeshSectionData>& RawData, const TArray<FBox>& CollisionBoxes, FString& OutTempFilePath)
+{
+	OutTempFilePath = GetMeshDataFilePath(FileName) + TEXT(".") + FGuid::NewGuid().ToString() + TEXT(".tmp");
+	FString UnrealFullFileName = OutTempFilePath;
 	UE_LOG(LogTemp, Display, TEXT("~~ Write FileName: %s"), *UnrealFullFileName);
 	
 	string FullFileName = string(TCHAR_TO_UTF8(*UnrealFullFileName));
 
+	vector<float> RawBoxes;
+	for (const FBox& Box : CollisionBoxes)
+	{
+		RawBoxes.insert(end(RawBoxes), { Box.Min.X, Box.Min.Y, Box.Min.Z, Box.Max.X, Box.Max.Y, Box.Max.Z });
+	}
+
 	string ErrorString = string();
-	if (EDGEMeshDataProvider::WriteToFile(FullFileName, RawData, ErrorString))
+	if (EDGEMeshDataProvider::WriteToFile(FullFileName, RawData, RawBoxes, ErrorString))
 	{
 		return true;
 	}
 	else
 	{
 		UE_LOG(LogTemp, Error, TEXT("%s"), *FString(ErrorString.c_str()));
+		IFileManager::Get().Delete(*OutTempFilePath, false, false, true);
+		return false;
+	}
+}
+
+bool UEDGEMeshUtility::CommitMeshDataFile(const FString& FileName, const FString& TempFilePath)
+{
+	if (!IFileManager::Get().Move(*GetMeshDataFilePath(FileName), *TempFilePath, true, true))
+	{
+		UE_LOG(LogTemp, Error, TEXT("~~ Couldn't move %s into place."), *TempFilePath);
+		IFileManager::Get().Delete(*TempFilePath, false, false, true);
 		return false;
 	}
+	return true;
 }
 
 bool UEDGEMeshUtility::ReadMeshDataFromFile(const FString& FileName, TArray<FRMCSectionData>& OutUnrealData, TArray<UMaterialInterface*>& Materials)
 {
-	FString UnrealFullFileName = FPlatformProcess::UserTempDir() + FString("EDGE/SavedMeshData/") + FileName + ".txt";
-	UE_LOG(LogTemp, Display, TEXT("~~ Read FileName: %s"), *UnrealFullFileName);
+	vector<EDGEMeshSectionData> RawData;
+	TArray<FBox> CollisionBoxes;
+	if (ReadRawMeshDataFromFile(FileName, RawData, CollisionBoxes))
+	{
+		ConvertSectionDataToUnreal(RawData, OutUnrealData, Materials);
+		return true;
+	}
+	return false;
+}
+
+// Touches no UObjects, so it is safe to call from worker threads
+bool UEDGEMeshUtility::ReadRawMeshDataFromFile(const FString& FileName, vector<EDGEMeshSectionData>& OutRawData, TArray<FBox>& OutCollisionBoxes)
+{
+	FString UnrealFullFileName = GetMeshDataFilePath(FileName);
+	UE_LOG(LogTemp, Verbose, TEXT("~~ Read FileName: %s"), *UnrealFullFileName);
 	
 	string FullFileName = string(TCHAR_TO_UTF8(*UnrealFullFileName));
-	vector<EDGEMeshSectionData> RawData;
 
+	vector<float> RawBoxes;
 	string ErrorString = string();
-	if (EDGEMeshDataProvider::ReadFromFile(FullFileName, RawData, ErrorString))
+	if (EDGEMeshDataProvider::ReadFromFile(FullFileName, OutRawData, RawBoxes, ErrorString))
 	{
-		ConvertSectionDataToUnreal(RawData, OutUnrealData, Materials);
+		OutCollisionBoxes.Empty(RawBoxes.size() / 6);
+		for (int Idx = 0; Idx + 5 < RawBoxes.size(); Idx += 6)
+		{
+			OutCollisionBoxes.Add(FBox(FVector(RawBoxes[Idx], RawBoxes[Idx+1], RawBoxes[Idx+2]), FVector(RawBoxes[Idx+3], RawBoxes[Idx+4], RawBoxes[Idx+5])));
+		}
 		return true;
 	}
 	else
@@ -222,8 +412,9 @@ bool UEDGEMeshUtility::ReadMeshDataFromFile(const FString& FileName, TArray<FRMC
 
 bool UEDGEMeshUtility::RemoveFile(const FString& FileName)
 {
-	FString UnrealFullFileName = FPlatformProcess::UserTempDir() + FString("EDGE/SavedMeshData/") + FileName + ".txt";
+	FString UnrealFullFileName = GetMeshDataFilePath(FileName);
 	UE_LOG(LogTemp, Display, TEXT("~~ Delete FileName: %s"), *UnrealFullFileName);
+	RemoveCollisionDataFiles(FileName);
 	
 	string FullFileName = string(TCHAR_TO_UTF8(*UnrealFullFileName));
 	string ErrorString = string();
@@ -293,8 +484,10 @@ void UEDGEMeshUtility::ConvertSectionDataToRaw(const TArray<FRMCSectionData>& Un
 			}
 		}
 		
+		RawSection.SectionData.resize(5);
 		RawSection.SectionData[0] = VertIdxCounter;		// MinVertIndex
 		RawSection.SectionData[2] = IndicesCounter;		// FirstTriIndex
+		RawSection.SectionData[4] = UnrealSection.LODIndex;
 		
 		for (FVector Vec : UnrealSection.Vertices)
 		{
@@ -332,6 +525,18 @@ void UEDGEMeshUtility::ConvertSectionDataToRaw(const TArray<FRMCSectionData>& Un
 }
 
 void UEDGEMeshUtility::ConvertSectionDataToUnreal(const vector<EDGEMeshSectionData>& RawData, TArray<FRMCSectionData>& OutUnrealData, TArray<UMaterialInterface*>& Materials)
+{
+	OutUnrealData.Empty();
+	OutUnrealData.SetNum(RawData.size());
+	for (int SectionIdx = 0; SectionIdx < RawData.size(); SectionIdx++)
+	{
+		ConvertRawSectionGeometry(RawData[SectionIdx], OutUnrealData[SectionIdx]);
+	}
+	ResolveSectionMaterials(RawData, OutUnrealData, Materials);
+}
+
+// Material slots of already converted sections. Reads the materials table, so game thread only.
+void UEDGEMeshUtility::ResolveSectionMaterials(const vector<EDGEMeshSectionData>& RawData, TArray<FRMCSectionData>& UnrealData, TArray<UMaterialInterface*>& Materials)
 {
 	UDataTable* MaterialsTable = Cast<UDataTable>(GetDefault<UEdgeHouseConstructorSettings>()->MaterialsDataTable.ResolveObject());
 	if (MaterialsTable == nullptr)
@@ -339,12 +544,12 @@ void UEDGEMeshUtility::ConvertSectionDataToUnreal(const vector<EDGEMeshSectionDa
 		UE_LOG(LogTemp, Warning, TEXT("Cant read materials data table for RMC building. Array will be filled with nullptrs."));
 	}
 	
-	OutUnrealData.Empty();
 	Materials.Empty();
 	
-	for (const auto& RawSection : RawData)
+	for (int SectionIdx = 0; SectionIdx < RawData.size(); SectionIdx++)
 	{
-		FRMCSectionData& UnrealSection = OutUnrealData.AddDefaulted_GetRef();
+		const EDGEMeshSectionData& RawSection = RawData[SectionIdx];
+		FRMCSectionData& UnrealSection = UnrealData[SectionIdx];
 		if (MaterialsTable != nullptr)
 		{
 			const FName RowName = *FString::Printf(TEXT("%s"), *FString(RawSection.MaterialName.c_str()));
@@ -364,20 +569,135 @@ void UEDGEMeshUtility::ConvertSectionDataToUnreal(const vector<EDGEMeshSectionDa
 		{
 			Materials.Add(nullptr);
 		}
-		
-		for (int Idx = 0; Idx < RawSection.Vertices.size(); Idx += 3)
-		{
-			UnrealSection.Vertices.Add(FVector(RawSection.Vertices[Idx], RawSection.Vertices[Idx+1], RawSection.Vertices[Idx+2]));
-			UnrealSection.Normals.Add(FVector(RawSection.Normals[Idx], RawSection.Normals[Idx+1], RawSection.Normals[Idx+2]));
-			UnrealSection.Tangents.Add(FVector(RawSection.Tangents[Idx], RawSection.Tangents[Idx+1], RawSection.Tangents[Idx+2]));
-		}
-		for (int Idx = 0; Idx < RawSection.UVs.size(); Idx += 2)
+	}
+}
+
+void UEDGEMeshUtility::ConvertRawSectionGeometry(const EDGEMeshSectionData& RawSection, FRMCSectionData& OutUnrealSection)
+{
+	OutUnrealSection.LODIndex = RawSection.SectionData[4];
+	for (int Idx = 0; Idx < RawSection.Vertices.size(); Idx += 3)
+	{
+		OutUnrealSection.Vertices.Add(FVector(RawSection.Vertices[Idx], RawSection.Vertices[Idx+1], RawSection.Vertices[Idx+2]));
+		OutUnrealSection.Normals.Add(FVector(RawSection.Normals[Idx], RawSection.Normals[Idx+1], RawSection.Normals[Idx+2]));
+		OutUnrealSection.Tangents.Add(FVector(RawSection.Tangents[Idx], RawSection.Tangents[Idx+1], RawSection.Tangents[Idx+2]));
+	}
+	for (int Idx = 0; Idx < RawSection.UVs.size(); Idx += 2)
+	{
+		OutUnrealSection.UVs.Add(FVector2D(RawSection.UVs[Idx], RawSection.UVs[Idx+1]));
+	}
+	for (auto Ind : RawSection.Indices)
+	{
+		OutUnrealSection.Faces.Add(Ind);
+	}
+}
+
+// Runtime counterpart of the merged mesh - no editor modules, sections go to the mesh through mesh descriptions
+UStaticMesh* UEDGEMeshUtility::BuildStaticMesh(UObject* Outer, const TArray<FRMCSectionData>& Sections, const TArray<UMaterialInterface*>& Materials, const TArray<float>& LODScreenSizes, const TArray<FBox>& CollisionBoxes)
+{
+	int NumLODs = 0;
+	for (const FRMCSectionData& Section : Sections)
+	{
+		NumLODs = FMath::Max(NumLODs, Section.LODIndex + 1);
+	}
+	if (NumLODs == 0 || Materials.Num() == 0)
+	{
+		return nullptr;
+	}
+
+	UStaticMesh* StaticMesh = NewObject<UStaticMesh>(Outer, NAME_None, RF_Transient);
+	for (int SlotIdx = 0; SlotIdx < Materials.Num(); SlotIdx++)
+	{
+		StaticMesh->StaticMaterials.Add(FStaticMaterial(Materials[SlotIdx], *FString::Printf(TEXT("Slot_%i"), SlotIdx)));
+	}
+
+	TArray<FMeshDescription> MeshDescriptions;
+	MeshDescriptions.SetNum(NumLODs);
+	for (int LODIdx = 0; LODIdx < NumLODs; LODIdx++)
+	{
+		FMeshDescription& Description = MeshDescriptions[LODIdx];
+		FStaticMeshAttributes Attributes(Description);
+		Attributes.Register();
+
+		TVertexAttributesRef<FVector> Positions = Attributes.GetVertexPositions();
+		TVertexInstanceAttributesRef<FVector> Normals = Attributes.GetVertexInstanceNormals();
+		TVertexInstanceAttributesRef<FVector> Tangents = Attributes.GetVertexInstanceTangents();
+		TVertexInstanceAttributesRef<float> BinormalSigns = Attributes.GetVertexInstanceBinormalSigns();
+		TVertexInstanceAttributesRef<FVector2D> UVs = Attributes.GetVertexInstanceUVs();
+		TPolygonGroupAttributesRef<FName> SlotNames = Attributes.GetPolygonGroupMaterialSlotNames();
+
+		// Polygon group per material slot, so mesh sections match the slots like in RMC
+		TMap<int, FPolygonGroupID> SlotGroups;
+		for (const FRMCSectionData& Section : Sections)
 		{
-			UnrealSection.UVs.Add(FVector2D(RawSection.UVs[Idx], RawSection.UVs[Idx+1]));
+			if (Section.LODIndex != LODIdx)
+			{
+				continue;
+			}
+
+			const int SlotIdx = Materials.IsValidIndex(Section.MaterialSlot) ? Section.MaterialSlot : 0;
+			if (!SlotGroups.Contains(SlotIdx))
+			{
+				const FPolygonGroupID NewGroup = Description.CreatePolygonGroup();
+				SlotNames[NewGroup] = StaticMesh->StaticMaterials[SlotIdx].MaterialSlotName;
+				SlotGroups.Add(SlotIdx, NewGroup);
+			}
+			const FPolygonGroupID GroupID = SlotGroups[SlotIdx];
+
+			TArray<FVertexInstanceID> VertexInstances;
+			VertexInstances.Reserve(Section.Vertices.Num());
+			for (int Idx = 0; Idx < Section.Vertices.Num(); Idx++)
+			{
+				const FVertexID VertexID = Description.CreateVertex();
+				Positions[VertexID] = Section.Vertices[Idx];
+
+				const FVertexInstanceID InstanceID = Description.CreateVertexInstance(VertexID);
+				Normals[InstanceID] = Section.Normals[Idx];
+				Tangents[InstanceID] = Section.Tangents[Idx];
+				BinormalSigns[InstanceID] = 1.f;
+				UVs.Set(InstanceID, 0, Section.UVs[Idx]);
+				VertexInstances.Add(InstanceID);
+			}
+
+			for (int Idx = 0; Idx + 2 < Section.Faces.Num(); Idx += 3)
+			{
+				const TArray<FVertexInstanceID> Triangle = { VertexInstances[Section.Faces[Idx]], VertexInstances[Section.Faces[Idx+1]], VertexInstances[Section.Faces[Idx+2]] };
+				Description.CreateTriangle(GroupID, Triangle);
+			}
 		}
-		for (auto Ind : RawSection.Indices)
+	}
+
+	TArray<const FMeshDescription*> MeshDescriptionPtrs;
+	for (const FMeshDescription& Description : MeshDescriptions)
+	{
+		MeshDescriptionPtrs.Add(&Description);
+	}
+
+	// Same boxes as the RMC collision of the house. Boxes need no cooking, so this works without editor modules too.
+	UStaticMesh::FBuildMeshDescriptionsParams Params;
+	Params.bBuildSimpleCollision = false;
+	StaticMesh->BuildFromMeshDescriptions(MeshDescriptionPtrs, Params);
+
+	if (CollisionBoxes.Num() > 0)
+	{
+		StaticMesh->CreateBodySetup();
+		UBodySetup* BodySetup = StaticMesh->BodySetup;
+		BodySetup->CollisionTraceFlag = CTF_UseSimpleAsComplex;
+		for (const FBox& Box : CollisionBoxes)
 		{
-			UnrealSection.Faces.Add(Ind);
+			FKBoxElem& BoxElem = BodySetup->AggGeom.BoxElems.AddDefaulted_GetRef();
+			BoxElem.Center = Box.GetCenter();
+			BoxElem.X = Box.GetSize().X;
+			BoxElem.Y = Box.GetSize().Y;
+			BoxElem.Z = Box.GetSize().Z;
 		}
+		BodySetup->CreatePhysicsMeshes();
 	}
+
+	StaticMesh->bAutoComputeLODScreenSize = false;
+	for (int LODIdx = 0; LODIdx < NumLODs && LODIdx < MAX_STATIC_MESH_LODS; LODIdx++)
+	{
+		StaticMesh->RenderData->ScreenSize[LODIdx].Default = LODScreenSizes.IsValidIndex(LODIdx) ? LODScreenSizes[LODIdx] : 0.f;
+	}
+
+	return StaticMesh;
 }
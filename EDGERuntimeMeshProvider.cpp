@@ -3,51 +3,237 @@
 
 #include "RuntimeMesh/EDGERuntimeMeshProvider.h"
 
+DECLARE_STATS_GROUP(TEXT("EDGE Runtime Mesh Provider"), STATGROUP_EDGERuntimeMeshProvider, STATCAT_Advanced);
+
+DECLARE_DWORD_COUNTER_STAT(TEXT("Snapshot Reads"), STAT_EDGEProvider_SnapshotReads, STATGROUP_EDGERuntimeMeshProvider);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Snapshots Published"), STAT_EDGEProvider_SnapshotsPublished, STATGROUP_EDGERuntimeMeshProvider);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Contended Lock Acquisitions"), STAT_EDGEProvider_ContendedLocks, STATGROUP_EDGERuntimeMeshProvider);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Lock Wait Time (ms)"), STAT_EDGEProvider_LockWaitTime, STATGROUP_EDGERuntimeMeshProvider);
+DECLARE_MEMORY_STAT(TEXT("Snapshot Memory"), STAT_EDGEProvider_SnapshotMemory, STATGROUP_EDGERuntimeMeshProvider);
+
+
+namespace
+{
+	// Anything above this is not just the cost of taking a free lock
+	constexpr uint32 ContendedLockCycles = 200;
+
+	void RecordLockWait(uint32 StartCycles)
+	{
+		const uint32 WaitCycles = FPlatformTime::Cycles() - StartCycles;
+		if (WaitCycles > ContendedLockCycles)
+		{
+			INC_DWORD_STAT(STAT_EDGEProvider_ContendedLocks);
+			INC_FLOAT_STAT_BY(STAT_EDGEProvider_LockWaitTime, FPlatformTime::ToMilliseconds(WaitCycles));
+		}
+	}
+}
+
+
+// Copies start uncounted, they are counted once published
+FEDGEMeshSnapshot::FEDGEMeshSnapshot(const FEDGEMeshSnapshot& Other)
+	: Sections(Other.Sections)
+	, Materials(Other.Materials)
+	, CollisionBoxes(Other.CollisionBoxes)
+	, MinBoundPoint(Other.MinBoundPoint)
+	, MaxBoundPoint(Other.MaxBoundPoint)
+	, TrackedBytes(0)
+{
+}
+
+FEDGEMeshSnapshot::~FEDGEMeshSnapshot()
+{
+	DEC_MEMORY_STAT_BY(STAT_EDGEProvider_SnapshotMemory, TrackedBytes);
+}
+
+// Counted once however many providers and caches share the snapshot. Published snapshots are never modified, so the size is final.
+void FEDGEMeshSnapshot::TrackMemory()
+{
+	if (TrackedBytes != 0)
+	{
+		return;
+	}
+	const int64 Bytes = GetAllocatedBytes();
+	if (FPlatformAtomics::InterlockedCompareExchange(&TrackedBytes, Bytes, 0) == 0)
+	{
+		INC_MEMORY_STAT_BY(STAT_EDGEProvider_SnapshotMemory, Bytes);
+	}
+}
+
+int64 FEDGEMeshSnapshot::GetAllocatedBytes() const
+{
+	int64 Bytes = sizeof(FEDGEMeshSnapshot) + Sections.GetAllocatedSize() + Materials.GetAllocatedSize() + CollisionBoxes.GetAllocatedSize();
+	for (const FRMCSectionData& Section : Sections)
+	{
+		Bytes += Section.Vertices.GetAllocatedSize() + Section.Normals.GetAllocatedSize() + Section.Tangents.GetAllocatedSize()
+				+ Section.UVs.GetAllocatedSize() + Section.Faces.GetAllocatedSize();
+	}
+	return Bytes;
+}
+
+
+FEDGEMeshSnapshotPtr UEDGERuntimeMeshProvider::GetSnapshot() const
+{
+	INC_DWORD_STAT(STAT_EDGEProvider_SnapshotReads);
+
+	// Lock is held only to copy the pointer. Data behind it is never modified after publication.
+	const uint32 StartCycles = FPlatformTime::Cycles();
+	FReadScopeLock Lock(SnapshotLock);
+	RecordLockWait(StartCycles);
+	return Snapshot;
+}
+
+void UEDGERuntimeMeshProvider::PublishSnapshot(FEDGEMeshSnapshotPtr NewSnapshot)
+{
+	INC_DWORD_STAT(STAT_EDGEProvider_SnapshotsPublished);
+
+	// Memory stat is kept by the snapshot itself, SnapshotBytes is only this provider's view of it for memory dumps
+	int64 NewBytes = 0;
+	if (NewSnapshot.IsValid())
+	{
+		NewSnapshot->TrackMemory();
+		NewBytes = NewSnapshot->GetAllocatedBytes();
+	}
+
+	const uint32 StartCycles = FPlatformTime::Cycles();
+	FWriteScopeLock Lock(SnapshotLock);
+	RecordLockWait(StartCycles);
+	Snapshot = MoveTemp(NewSnapshot);
+	SnapshotBytes = NewBytes;
+}
+
+int64 UEDGERuntimeMeshProvider::GetSnapshotBytes() const
+{
+	FReadScopeLock Lock(SnapshotLock);
+	return SnapshotBytes;
+}
+
+void UEDGERuntimeMeshProvider::BeginDestroy()
+{
+	PublishSnapshot(nullptr);
+	Super::BeginDestroy();
+}
+
+TSharedRef<FEDGEMeshSnapshot, ESPMode::ThreadSafe> UEDGERuntimeMeshProvider::CopySnapshot() const
+{
+	const FEDGEMeshSnapshotPtr Current = GetSnapshot();
+	return Current.IsValid() ? MakeShared<FEDGEMeshSnapshot, ESPMode::ThreadSafe>(*Current) : MakeShared<FEDGEMeshSnapshot, ESPMode::ThreadSafe>();
+}
+
+// Writers hold WriterLock from copy to publish, so concurrent setters don't lose each other's changes. Readers never wait on it.
+void UEDGERuntimeMeshProvider::ModifySnapshot(TFunctionRef<void(FEDGEMeshSnapshot&)> Modify)
+{
+	FScopeLock Lock(&WriterLock);
+	TSharedRef<FEDGEMeshSnapshot, ESPMode::ThreadSafe> NewSnapshot = CopySnapshot();
+	Modify(NewSnapshot.Get());
+	PublishSnapshot(NewSnapshot);
+}
+
 void UEDGERuntimeMeshProvider::SetSectionsData(TArray<FRMCSectionData> SectionsData)
 {
-	FScopeLock Lock(&PropertySyncRoot);
-	ClearSectionsData_Unsynced();		// We already locked scope, no reason to use normal version
-	MeshSectionData = SectionsData;
-	CalculateBoundsPoints();
-	bHaveMeshData = true;
+	ModifySnapshot([&SectionsData](FEDGEMeshSnapshot& Data)
+	{
+		Data.Sections = MoveTemp(SectionsData);
+		CalculateBoundsPoints(Data);
+	});
+
+	MarkAllLODsDirty();
+	MarkCollisionDirty();
+}
+
+// Patches a bound mesh in place: only listed sections are rebuilt. False if sections or materials are laid out differently - that needs SetSectionsData and a new Initialize.
+bool UEDGERuntimeMeshProvider::UpdateSectionsData(TArray<FRMCSectionData> SectionsData, const TArray<UMaterialInterface*>& InMaterials, const TArray<int32>& DirtySections)
+{
+	FScopeLock Lock(&WriterLock);
+	const FEDGEMeshSnapshotPtr Current = GetSnapshot();
+	if (!IsBound() || !Current.IsValid() || Current->Materials != InMaterials || Current->Sections.Num() != SectionsData.Num())
+	{
+		return false;
+	}
+	for (int SectionIdx = 0; SectionIdx < SectionsData.Num(); SectionIdx++)
+	{
+		if (Current->Sections[SectionIdx].LODIndex != SectionsData[SectionIdx].LODIndex || Current->Sections[SectionIdx].MaterialSlot != SectionsData[SectionIdx].MaterialSlot)
+		{
+			return false;
+		}
+	}
+
+	// Sections are replaced as a whole, so there is no point copying the old ones
+	TSharedRef<FEDGEMeshSnapshot, ESPMode::ThreadSafe> NewSnapshot = MakeShared<FEDGEMeshSnapshot, ESPMode::ThreadSafe>();
+	NewSnapshot->Materials = Current->Materials;
+	NewSnapshot->CollisionBoxes = Current->CollisionBoxes;
+	NewSnapshot->Sections = MoveTemp(SectionsData);
+	CalculateBoundsPoints(NewSnapshot.Get());
+	PublishSnapshot(NewSnapshot);
+
+	for (const int32 SectionIdx : DirtySections)
+	{
+		MarkSectionDirty(NewSnapshot->Sections[SectionIdx].LODIndex, SectionIdx);
+	}
+	MarkCollisionDirty();
+	return true;
 }
 
 void UEDGERuntimeMeshProvider::AddSectionData(FRMCSectionData SectionData)
 {
-	FScopeLock Lock(&PropertySyncRoot);
-	MeshSectionData.Add(SectionData);
+	ModifySnapshot([&SectionData](FEDGEMeshSnapshot& Data)
+	{
+		Data.Sections.Add(MoveTemp(SectionData));
+	});
 }
 
 void UEDGERuntimeMeshProvider::ClearSectionsData()
 {
-	FScopeLock Lock(&PropertySyncRoot);
-	ClearSectionsData_Unsynced();
+	ModifySnapshot([](FEDGEMeshSnapshot& Data)
+	{
+		Data.Sections.Empty();
+		Data.MinBoundPoint = FVector(0.f);
+		Data.MaxBoundPoint = FVector(0.f);
+	});
 }
 
-void UEDGERuntimeMeshProvider::ClearSectionsData_Unsynced()
+// Same data and settings, for a mesh bound by many houses instead of this provider's owner only
+UEDGERuntimeMeshProvider* UEDGERuntimeMeshProvider::CreateSharedCopy(UObject* Outer) const
 {
-	MeshSectionData.Empty();
-	MinBoundPoint = FVector(0.f);
-	MaxBoundPoint = FVector(0.f);
-	bHaveMeshData = false;
+	UEDGERuntimeMeshProvider* Copy = NewObject<UEDGERuntimeMeshProvider>(Outer, NAME_None, RF_Transient);
+	Copy->SetTemplateName(GetTemplateName());
+	Copy->SetLODSettings(LODScreenSizes, LODCastShadows);
+	Copy->PublishSnapshot(GetSnapshot());
+	return Copy;
 }
 
-bool UEDGERuntimeMeshProvider::GetSectionMeshForLOD_Unsynced(int32 LODIndex, int32 SectionIdx, FRuntimeMeshRenderableMeshData& MeshData)
+void UEDGERuntimeMeshProvider::SetSnapshot(FEDGEMeshSnapshotPtr InSnapshot)
 {
-	if (!MeshSectionData.IsValidIndex(SectionIdx))
+	{
+		FScopeLock Lock(&WriterLock);
+		PublishSnapshot(MoveTemp(InSnapshot));
+	}
+
+	MarkAllLODsDirty();
+	MarkCollisionDirty();
+}
+
+bool UEDGERuntimeMeshProvider::GetSectionMeshForLOD_Snapshot(const FEDGEMeshSnapshot& Data, int32 LODIndex, int32 SectionIdx, FRuntimeMeshRenderableMeshData& MeshData)
+{
+	if (!Data.Sections.IsValidIndex(SectionIdx))
 	{
 		return false;
 	}
-	
-	for (int Idx = 0; Idx < MeshSectionData[SectionIdx].Vertices.Num(); Idx++)
+
+	const FRMCSectionData& Section = Data.Sections[SectionIdx];
+	if (Section.LODIndex != LODIndex)
 	{
-		MeshData.Positions.Add(MeshSectionData[SectionIdx].Vertices[Idx]);
-		MeshData.Tangents.Add(MeshSectionData[SectionIdx].Normals[Idx], MeshSectionData[SectionIdx].Tangents[Idx]);
+		return false;
+	}
+
+	for (int Idx = 0; Idx < Section.Vertices.Num(); Idx++)
+	{
+		MeshData.Positions.Add(Section.Vertices[Idx]);
+		MeshData.Tangents.Add(Section.Normals[Idx], Section.Tangents[Idx]);
 		MeshData.Colors.Add(FColor(0.f, 0.f, 0.f, 1.f));
-		MeshData.TexCoords.Add(MeshSectionData[SectionIdx].UVs[Idx]);
+		MeshData.TexCoords.Add(Section.UVs[Idx]);
 	}
 
-	for (int Tris : MeshSectionData[SectionIdx].Faces)
+	for (int Tris : Section.Faces)
 	{
 		MeshData.Triangles.Add(Tris);
 	}
@@ -57,120 +243,220 @@ bool UEDGERuntimeMeshProvider::GetSectionMeshForLOD_Unsynced(int32 LODIndex, int
 
 FVector UEDGERuntimeMeshProvider::GetBoxRadius() const
 {
-	FScopeLock Lock(&PropertySyncRoot);
-	return (MaxBoundPoint - MinBoundPoint) / 2.f;
+	const FEDGEMeshSnapshotPtr Data = GetSnapshot();
+	return Data.IsValid() ? (Data->MaxBoundPoint - Data->MinBoundPoint) / 2.f : FVector(0.f);
 }
 
 FVector UEDGERuntimeMeshProvider::GetBoxCenter() const
 {
-	FScopeLock Lock(&PropertySyncRoot);
-	return MinBoundPoint + (MaxBoundPoint - MinBoundPoint) / 2.f;
+	const FEDGEMeshSnapshotPtr Data = GetSnapshot();
+	return Data.IsValid() ? Data->MinBoundPoint + (Data->MaxBoundPoint - Data->MinBoundPoint) / 2.f : FVector(0.f);
 }
 
 bool UEDGERuntimeMeshProvider::HaveMeshData() const
 {
-	return bHaveMeshData
-		   && MeshSectionData.Num() > 0
-		   && Materials.Num() > 0;
+	const FEDGEMeshSnapshotPtr Data = GetSnapshot();
+	return Data.IsValid()
+		   && Data->Sections.Num() > 0
+		   && Data->Materials.Num() > 0;
 }
 
 
-void UEDGERuntimeMeshProvider::CalculateBoundsPoints()
+void UEDGERuntimeMeshProvider::CalculateBoundsPoints(FEDGEMeshSnapshot& Data)
 {
-	FScopeLock Lock(&PropertySyncRoot);
-
 	FVector MinV = FVector(90000.f);
 	FVector MaxV = FVector(-90000.f);
 
-	for (FRMCSectionData Data : MeshSectionData)
+	for (const FRMCSectionData& Section : Data.Sections)
 	{
-		for (FVector Vec : Data.Vertices)
+		for (const FVector& Vec : Section.Vertices)
 		{
 			MinV.X = FMath::Min(MinV.X, Vec.X);
 			MinV.Y = FMath::Min(MinV.Y, Vec.Y);
 			MinV.Z = FMath::Min(MinV.Z, Vec.Z);
-		
+
 			MaxV.X = FMath::Max(MaxV.X, Vec.X);
 			MaxV.Y = FMath::Max(MaxV.Y, Vec.Y);
 			MaxV.Z = FMath::Max(MaxV.Z, Vec.Z);
 		}
 	}
 
-	MinBoundPoint = MinV;
-	MaxBoundPoint = MaxV;
-
-	MarkAllLODsDirty();
-	MarkCollisionDirty();
+	Data.MinBoundPoint = MinV;
+	Data.MaxBoundPoint = MaxV;
 }
 
 TArray<FRMCSectionData> UEDGERuntimeMeshProvider::GetSectionData() const
 {
-	FScopeLock Lock(&PropertySyncRoot);
-	return MeshSectionData;
+	const FEDGEMeshSnapshotPtr Data = GetSnapshot();
+	return Data.IsValid() ? Data->Sections : TArray<FRMCSectionData>();
 }
 
 TArray<UMaterialInterface*> UEDGERuntimeMeshProvider::GetMaterials() const
 {
-	FScopeLock Lock(&PropertySyncRoot);
-	return Materials;
+	const FEDGEMeshSnapshotPtr Data = GetSnapshot();
+	return Data.IsValid() ? Data->Materials : TArray<UMaterialInterface*>();
+}
+
+TArray<FBox> UEDGERuntimeMeshProvider::GetCollisionBoxes() const
+{
+	const FEDGEMeshSnapshotPtr Data = GetSnapshot();
+	return Data.IsValid() ? GetCollisionBoxes_Snapshot(*Data) : TArray<FBox>();
 }
 
 
 UMaterialInterface* UEDGERuntimeMeshProvider::GetMaterialFromSlot(int SlotIndex) const
 {
-	FScopeLock Lock(&PropertySyncRoot);
+	const FEDGEMeshSnapshotPtr Data = GetSnapshot();
 
-	if (!Materials.IsValidIndex(SlotIndex))
+	if (!Data.IsValid() || !Data->Materials.IsValidIndex(SlotIndex))
 	{
 		return nullptr;
 	}
-	
-	return Materials[SlotIndex];
+
+	return Data->Materials[SlotIndex];
 }
 
 void UEDGERuntimeMeshProvider::SetMaterials(TArray<UMaterialInterface*> InMaterials)
 {
-	FScopeLock Lock(&PropertySyncRoot);
-
-	Materials = InMaterials;
+	ModifySnapshot([&InMaterials](FEDGEMeshSnapshot& Data)
+	{
+		Data.Materials = MoveTemp(InMaterials);
+	});
 }
 
 void UEDGERuntimeMeshProvider::AddMaterial(UMaterialInterface* InMaterial)
 {
-	FScopeLock Lock(&PropertySyncRoot);
-	
-	Materials.Add(InMaterial);
+	ModifySnapshot([InMaterial](FEDGEMeshSnapshot& Data)
+	{
+		Data.Materials.Add(InMaterial);
+	});
 
 	// const int SlotIndex = Materials.Num() - 1;
 	// const FName SlotName = *FString::Printf(TEXT("Slot_%i"), SlotIndex);
 	// SetupMaterialSlot(SlotIndex, SlotName, Materials[SlotIndex]);
 }
 
+void UEDGERuntimeMeshProvider::AddReferencedObjects(UObject* InThis, FReferenceCollector& Collector)
+{
+	UEDGERuntimeMeshProvider* This = CastChecked<UEDGERuntimeMeshProvider>(InThis);
+
+	// Materials live in the snapshot, which is not visible to reflection. Not a GetSnapshot call, so GC doesn't count as reads.
+	FEDGEMeshSnapshotPtr Data;
+	{
+		FReadScopeLock Lock(This->SnapshotLock);
+		Data = This->Snapshot;
+	}
+	if (Data.IsValid())
+	{
+		for (UMaterialInterface* Material : Data->Materials)
+		{
+			Collector.AddReferencedObject(Material, This);
+		}
+	}
+
+	Super::AddReferencedObjects(InThis, Collector);
+}
+
+
+
 
+void UEDGERuntimeMeshProvider::SetLODSettings(const TArray<float>& InLODScreenSizes, const TArray<bool>& InLODCastShadows)
+{
+	LODScreenSizes = InLODScreenSizes;
+	LODCastShadows = InLODCastShadows;
 
+	if (!IsBound())
+	{
+		return;
+	}
+
+	// Already running - push new screen sizes and shadow flags without recreating sections
+	const int NumLODs = GetNumLODs();
+	for (int LODIdx = 0; LODIdx < NumLODs; LODIdx++)
+	{
+		SetLODScreenSize(LODIdx, GetLODScreenSize(LODIdx, NumLODs));
+	}
+	const FEDGEMeshSnapshotPtr Data = GetSnapshot();
+	for (int SectionIdx = 0; Data.IsValid() && SectionIdx < Data->Sections.Num(); SectionIdx++)
+	{
+		const int LODIdx = Data->Sections[SectionIdx].LODIndex;
+		SetSectionCastsShadow(LODIdx, SectionIdx, LODCastShadows.IsValidIndex(LODIdx) ? LODCastShadows[LODIdx] : true);
+	}
+}
+
+int UEDGERuntimeMeshProvider::GetNumLODs() const
+{
+	const FEDGEMeshSnapshotPtr Data = GetSnapshot();
+	int NumLODs = 1;
+	if (Data.IsValid())
+	{
+		for (const FRMCSectionData& Section : Data->Sections)
+		{
+			NumLODs = FMath::Max(NumLODs, Section.LODIndex + 1);
+		}
+	}
+	return NumLODs;
+}
+
+float UEDGERuntimeMeshProvider::GetLODScreenSize(int LODIndex, int NumLODs) const
+{
+	// Single LOD is always visible
+	if (NumLODs <= 1)
+	{
+		return 0.f;
+	}
+	if (LODScreenSizes.IsValidIndex(LODIndex))
+	{
+		return LODScreenSizes[LODIndex];
+	}
+	// No configured value - every next LOD kicks in at half of the previous screen size
+	return FMath::Pow(0.5f, LODIndex);
+}
+
+TArray<float> UEDGERuntimeMeshProvider::GetLODScreenSizes() const
+{
+	const int NumLODs = GetNumLODs();
+	TArray<float> ScreenSizes;
+	for (int LODIdx = 0; LODIdx < NumLODs; LODIdx++)
+	{
+		ScreenSizes.Add(GetLODScreenSize(LODIdx, NumLODs));
+	}
+	return ScreenSizes;
+}
 
 void UEDGERuntimeMeshProvider::Initialize()
 {
-	int LODIdx = 0;	// TODO: Waiting LODs implementation
-	FRuntimeMeshLODProperties LODProperties;
-	LODProperties.ScreenSize = 0.0f;
+	const FEDGEMeshSnapshotPtr Data = GetSnapshot();
+	if (!Data.IsValid())
+	{
+		return;
+	}
+
+	const int NumLODs = GetNumLODs();
+	TArray<FRuntimeMeshLODProperties> LODProperties;
+	LODProperties.SetNum(NumLODs);
+	for (int LODIdx = 0; LODIdx < NumLODs; LODIdx++)
+	{
+		LODProperties[LODIdx].ScreenSize = GetLODScreenSize(LODIdx, NumLODs);
+	}
+
+	ConfigureLODs(LODProperties);
 
-	ConfigureLODs({ LODProperties });
 
-	
 	FRuntimeMeshSectionProperties Properties;
-	Properties.bCastsShadow = true;
 	Properties.bIsVisible = true;
 	Properties.UpdateFrequency = ERuntimeMeshUpdateFrequency::Infrequent;
 
-	for (int SectionIdx = 0; SectionIdx < MeshSectionData.Num(); SectionIdx++)
+	for (int SectionIdx = 0; SectionIdx < Data->Sections.Num(); SectionIdx++)
 	{
-		const int SlotIdx = (Materials.IsValidIndex(MeshSectionData[SectionIdx].MaterialSlot)) ? MeshSectionData[SectionIdx].MaterialSlot : 0;
+		const int LODIdx = Data->Sections[SectionIdx].LODIndex;
+		const int SlotIdx = (Data->Materials.IsValidIndex(Data->Sections[SectionIdx].MaterialSlot)) ? Data->Sections[SectionIdx].MaterialSlot : 0;
 		const FName SlotName = *FString::Printf(TEXT("Slot_%i"), SlotIdx);
-		
-		SetupMaterialSlot(SlotIdx, SlotName, Materials[SlotIdx]);
-		
+
+		SetupMaterialSlot(SlotIdx, SlotName, Data->Materials[SlotIdx]);
+
 		Properties.MaterialSlot = SlotIdx;
+		Properties.bCastsShadow = LODCastShadows.IsValidIndex(LODIdx) ? LODCastShadows[LODIdx] : true;
 		CreateSection(LODIdx, SectionIdx, Properties);
 	}
 
@@ -179,48 +465,94 @@ void UEDGERuntimeMeshProvider::Initialize()
 
 FBoxSphereBounds UEDGERuntimeMeshProvider::GetBounds()
 {
-	return FBoxSphereBounds(FBox(MinBoundPoint, MaxBoundPoint));
+	const FEDGEMeshSnapshotPtr Data = GetSnapshot();
+	if (!Data.IsValid())
+	{
+		return FBoxSphereBounds(FSphere(FVector::ZeroVector, 1.0f));
+	}
+	return FBoxSphereBounds(FBox(Data->MinBoundPoint, Data->MaxBoundPoint));
 }
 
 bool UEDGERuntimeMeshProvider::GetSectionMeshForLOD(int32 LODIndex, int32 SectionIdx, FRuntimeMeshRenderableMeshData& MeshData)
 {	// We should only ever be queried for section 0 and lod 0
 	// check(SectionId == 0 && LODIndex == 0);			// Are we really need this???
 
-	FScopeLock Lock(&PropertySyncRoot);
+	// Worker threads only hold the snapshot reference, so concurrent section reads never wait on each other
+	const FEDGEMeshSnapshotPtr Data = GetSnapshot();
+	if (!Data.IsValid())
+	{
+		return false;
+	}
 
-	return GetSectionMeshForLOD_Unsynced(LODIndex, SectionIdx, MeshData);
+	return GetSectionMeshForLOD_Snapshot(*Data, LODIndex, SectionIdx, MeshData);
 }
 
 bool UEDGERuntimeMeshProvider::GetAllSectionsMeshForLOD(int32 LODIndex, TMap<int32, FRuntimeMeshSectionData>& MeshDatas)
 {
 	return false;
-	
-	FScopeLock Lock(&PropertySyncRoot);
+
+	const FEDGEMeshSnapshotPtr Data = GetSnapshot();
+	if (!Data.IsValid())
+	{
+		return false;
+	}
 
 	// TODO: Need more exploring...
-	for (int SectionIdx = 0; SectionIdx < MeshSectionData.Num(); SectionIdx++)
+	for (int SectionIdx = 0; SectionIdx < Data->Sections.Num(); SectionIdx++)
 	{
+		if (Data->Sections[SectionIdx].LODIndex != LODIndex)
+		{
+			continue;
+		}
 		FRuntimeMeshSectionData NewData;
-		if (GetSectionMeshForLOD_Unsynced(LODIndex, SectionIdx, NewData.MeshData) == false)
+		if (GetSectionMeshForLOD_Snapshot(*Data, LODIndex, SectionIdx, NewData.MeshData) == false)
 		{
 			return false;
 		}
 		MeshDatas.Add(SectionIdx, NewData);
 	}
-	
+
 	return true;
 }
 
+void UEDGERuntimeMeshProvider::SetCollisionBoxes(TArray<FBox> CollisionBoxes)
+{
+	ModifySnapshot([&CollisionBoxes](FEDGEMeshSnapshot& Data)
+	{
+		Data.CollisionBoxes = MoveTemp(CollisionBoxes);
+	});
+
+	MarkCollisionDirty();
+}
+
+// Per part boxes generated with the house, or whole bounds for data saved without them
+TArray<FBox> UEDGERuntimeMeshProvider::GetCollisionBoxes_Snapshot(const FEDGEMeshSnapshot& Data)
+{
+	if (Data.CollisionBoxes.Num() > 0)
+	{
+		return Data.CollisionBoxes;
+	}
+	return { FBox(Data.MinBoundPoint, Data.MaxBoundPoint) };
+}
+
 FRuntimeMeshCollisionSettings UEDGERuntimeMeshProvider::GetCollisionSettings()
 {
 	FRuntimeMeshCollisionSettings Settings;
 	Settings.bUseAsyncCooking = true;
 	Settings.bUseComplexAsSimple = false;
 
-	FVector Extents = FVector(MaxBoundPoint.X - MinBoundPoint.X, MaxBoundPoint.Y - MinBoundPoint.Y, MaxBoundPoint.Z - MinBoundPoint.Z);
-	FVector Center = MinBoundPoint + (MaxBoundPoint - MinBoundPoint) / 2.f;
-	Settings.Boxes.Emplace(Center, FRotator(0.f), Extents.X, Extents.Y, Extents.Z);
-	
+	const FEDGEMeshSnapshotPtr Data = GetSnapshot();
+	if (!Data.IsValid())
+	{
+		return Settings;
+	}
+
+	for (const FBox& Box : GetCollisionBoxes_Snapshot(*Data))
+	{
+		const FVector Extents = Box.GetSize();
+		Settings.Boxes.Emplace(Box.GetCenter(), FRotator(0.f), Extents.X, Extents.Y, Extents.Z);
+	}
+
 	return Settings;
 }
 
@@ -231,42 +563,55 @@ bool UEDGERuntimeMeshProvider::HasCollisionMesh()
 
 bool UEDGERuntimeMeshProvider::GetCollisionMesh(FRuntimeMeshCollisionData& CollisionData)
 {
-	// Add the single collision section
-	CollisionData.CollisionSources.Emplace(0, 5, this, 0, ERuntimeMeshCollisionFaceSourceType::Collision);
+	const FEDGEMeshSnapshotPtr Data = GetSnapshot();
+	if (!Data.IsValid())
+	{
+		return false;
+	}
+	const TArray<FBox> Boxes = GetCollisionBoxes_Snapshot(*Data);
+
+	// Single collision section with all boxes, 12 triangles each
+	CollisionData.CollisionSources.Emplace(0, Boxes.Num() * 12 - 1, this, 0, ERuntimeMeshCollisionFaceSourceType::Collision);
 
 	FRuntimeMeshCollisionVertexStream& CollisionVertices = CollisionData.Vertices;
 	FRuntimeMeshCollisionTriangleStream& CollisionTriangles = CollisionData.Triangles;
 
-
-	// Generate verts
-	CollisionVertices.Add(FVector(MinBoundPoint.X, MaxBoundPoint.Y, MaxBoundPoint.Z));
-	CollisionVertices.Add(FVector(MaxBoundPoint.X, MaxBoundPoint.Y, MaxBoundPoint.Z));
-	CollisionVertices.Add(FVector(MaxBoundPoint.X, MinBoundPoint.Y, MaxBoundPoint.Z));
-	CollisionVertices.Add(FVector(MaxBoundPoint.X, MinBoundPoint.Y, MaxBoundPoint.Z));
-
-	CollisionVertices.Add(FVector(MinBoundPoint.X, MaxBoundPoint.Y, MinBoundPoint.Z));
-	CollisionVertices.Add(FVector(MaxBoundPoint.X, MaxBoundPoint.Y, MinBoundPoint.Z));
-	CollisionVertices.Add(FVector(MaxBoundPoint.X, MinBoundPoint.Y, MinBoundPoint.Z));
-	CollisionVertices.Add(FVector(MinBoundPoint.X, MinBoundPoint.Y, MinBoundPoint.Z));
-
-	// Pos Z
-	CollisionTriangles.Add(0, 1, 3);
-	CollisionTriangles.Add(1, 2, 3);
-	// Neg X
-	CollisionTriangles.Add(4, 0, 7);
-	CollisionTriangles.Add(0, 3, 7);
-	// Pos Y
-	CollisionTriangles.Add(5, 1, 4);
-	CollisionTriangles.Add(1, 0, 4);
-	// Pos X
-	CollisionTriangles.Add(6, 2, 5);
-	CollisionTriangles.Add(2, 1, 5);
-	// Neg Y
-	CollisionTriangles.Add(7, 3, 6);
-	CollisionTriangles.Add(3, 2, 6);
-	// Neg Z
-	CollisionTriangles.Add(7, 6, 4);
-	CollisionTriangles.Add(6, 5, 4);
+	for (const FBox& Box : Boxes)
+	{
+		const FVector& MinBoundPoint = Box.Min;
+		const FVector& MaxBoundPoint = Box.Max;
+		const int32 First = CollisionVertices.Num();
+
+		// Generate verts
+		CollisionVertices.Add(FVector(MinBoundPoint.X, MaxBoundPoint.Y, MaxBoundPoint.Z));
+		CollisionVertices.Add(FVector(MaxBoundPoint.X, MaxBoundPoint.Y, MaxBoundPoint.Z));
+		CollisionVertices.Add(FVector(MaxBoundPoint.X, MinBoundPoint.Y, MaxBoundPoint.Z));
+		CollisionVertices.Add(FVector(MinBoundPoint.X, MinBoundPoint.Y, MaxBoundPoint.Z));
+
+		CollisionVertices.Add(FVector(MinBoundPoint.X, MaxBoundPoint.Y, MinBoundPoint.Z));
+		CollisionVertices.Add(FVector(MaxBoundPoint.X, MaxBoundPoint.Y, MinBoundPoint.Z));
+		CollisionVertices.Add(FVector(MaxBoundPoint.X, MinBoundPoint.Y, MinBoundPoint.Z));
+		CollisionVertices.Add(FVector(MinBoundPoint.X, MinBoundPoint.Y, MinBoundPoint.Z));
+
+		// Pos Z
+		CollisionTriangles.Add(First + 0, First + 1, First + 3);
+		CollisionTriangles.Add(First + 1, First + 2, First + 3);
+		// Neg X
+		CollisionTriangles.Add(First + 4, First + 0, First + 7);
+		CollisionTriangles.Add(First + 0, First + 3, First + 7);
+		// Pos Y
+		CollisionTriangles.Add(First + 5, First + 1, First + 4);
+		CollisionTriangles.Add(First + 1, First + 0, First + 4);
+		// Pos X
+		CollisionTriangles.Add(First + 6, First + 2, First + 5);
+		CollisionTriangles.Add(First + 2, First + 1, First + 5);
+		// Neg Y
+		CollisionTriangles.Add(First + 7, First + 3, First + 6);
+		CollisionTriangles.Add(First + 3, First + 2, First + 6);
+		// Neg Z
+		CollisionTriangles.Add(First + 7, First + 6, First + 4);
+		CollisionTriangles.Add(First + 6, First + 5, First + 4);
+	}
 
 	return true;
 }
@@ -274,4 +619,4 @@ bool UEDGERuntimeMeshProvider::GetCollisionMesh(FRuntimeMeshCollisionData& Colli
 bool UEDGERuntimeMeshProvider::IsThreadSafe()
 {
 	return true;
-}
\ No newline at end of file
+}
@@ -0,0 +1,158 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "HouseEditor/HouseBuildScheduler.h"
+#include "HouseEditor/HouseEditor.h"
+#include "HouseEditor/HouseEditorFunctionLibrary.h"
+#include "HouseEditor/HouseEditorStats.h"
+
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+#include "RuntimeMesh/EDGERuntimeMeshProvider.h"
+
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Queued House Tasks"), STAT_EDGEHouses_QueuedTasks, STATGROUP_EDGEHouses);
+DECLARE_DWORD_COUNTER_STAT(TEXT("House Tasks Done"), STAT_EDGEHouses_TasksDone, STATGROUP_EDGEHouses);
+DECLARE_CYCLE_STAT(TEXT("Build Scheduler Tick"), STAT_EDGEHouses_SchedulerTick, STATGROUP_EDGEHouses);
+
+static TAutoConsoleVariable<float> CVarHouseBuildBudgetMs(
+	TEXT("EDGE.Houses.BuildBudgetMs"),
+	4.f,
+	TEXT("Game thread time per frame given to queued house builds and mesh bindings, in ms. At least one task runs every frame."));
+
+static TAutoConsoleVariable<int32> CVarHouseBuildScheduler(
+	TEXT("EDGE.Houses.BuildScheduler"),
+	1,
+	TEXT("If on, houses and city items of a game world are built over several frames, nearest to the player first. Otherwise they are built right away."));
+
+// Only game worlds get one - editor builds stay immediate
+bool UHouseBuildScheduler::ShouldCreateSubsystem(UObject* Outer) const
+{
+	const UWorld* World = Cast<UWorld>(Outer);
+	return World != nullptr && World->IsGameWorld();
+}
+
+void UHouseBuildScheduler::Deinitialize()
+{
+	DEC_DWORD_STAT_BY(STAT_EDGEHouses_QueuedTasks, Tasks.Num());
+	Tasks.Empty();
+	Super::Deinitialize();
+}
+
+// Null if builds should happen right away
+UHouseBuildScheduler* UHouseBuildScheduler::Get(const UObject* WorldContext)
+{
+	const UWorld* World = WorldContext != nullptr ? WorldContext->GetWorld() : nullptr;
+	if (World == nullptr || CVarHouseBuildScheduler.GetValueOnGameThread() == 0)
+	{
+		return nullptr;
+	}
+	return World->GetSubsystem<UHouseBuildScheduler>();
+}
+
+void UHouseBuildScheduler::QueueBuild(AHouseEditor* House)
+{
+	QueueTask(House, EHouseBuildTaskType::Build, [House]()
+	{
+		House->GenerateMeshData();
+		House->ClearHouse();
+		if (House->GetRMCProvider()->HaveMeshData())
+		{
+			House->BindRuntimeMesh();
+		}
+	});
+}
+
+void UHouseBuildScheduler::QueueBind(AHouseEditor* House)
+{
+	QueueTask(House, EHouseBuildTaskType::Bind, [House]()
+	{
+		if (House->GetRMCProvider() != nullptr && House->GetRMCProvider()->HaveMeshData())
+		{
+			House->BindRuntimeMesh();
+		}
+	});
+}
+
+// Task is dropped if its actor is gone before its turn. Build replaces a pending bind of the same actor, as it binds anyway.
+void UHouseBuildScheduler::QueueTask(AActor* Target, EHouseBuildTaskType Type, TFunction<void()> Work)
+{
+	if (Target == nullptr)
+	{
+		return;
+	}
+
+	for (FHouseBuildTask& Task : Tasks)
+	{
+		if (Task.Target == Target && Task.Type != EHouseBuildTaskType::Custom && (Task.Type == Type || Type == EHouseBuildTaskType::Build))
+		{
+			Task.Type = Type;
+			Task.Work = MoveTemp(Work);
+			return;
+		}
+	}
+
+	FHouseBuildTask& Task = Tasks.AddDefaulted_GetRef();
+	Task.Target = Target;
+	Task.Type = Type;
+	Task.Work = MoveTemp(Work);
+	INC_DWORD_STAT(STAT_EDGEHouses_QueuedTasks);
+
+	if (Tasks.Num() == 1)
+	{
+		QueueStartTime = FPlatformTime::Seconds();
+		NumDone = 0;
+	}
+}
+
+void UHouseBuildScheduler::Tick(float DeltaTime)
+{
+	SCOPE_CYCLE_COUNTER(STAT_EDGEHouses_SchedulerTick);
+
+	// View moves, so the order is refreshed every frame. Without a player it is the camera that rendered last frame.
+	FVector ViewLocation = FVector::ZeroVector;
+	UHouseEditorFunctionLibrary::GetViewLocation(GetWorld(), ViewLocation);
+	for (FHouseBuildTask& Task : Tasks)
+	{
+		Task.Distance = Task.Target.IsValid() ? FVector::DistSquared(Task.Target->GetActorLocation(), ViewLocation) : 0.f;
+	}
+	// Nearest last, so finished tasks are popped off the end
+	Tasks.StableSort([](const FHouseBuildTask& A, const FHouseBuildTask& B)
+	{
+		return A.Distance > B.Distance;
+	});
+
+	const double EndTime = FPlatformTime::Seconds() + CVarHouseBuildBudgetMs.GetValueOnGameThread() / 1000.0;
+	do
+	{
+		// Work may queue more tasks, so the task leaves the queue before it runs
+		const FHouseBuildTask Task = Tasks.Pop(false);
+		DEC_DWORD_STAT(STAT_EDGEHouses_QueuedTasks);
+		if (AActor* Target = Task.Target.Get())
+		{
+			Task.Work();
+			NumDone++;
+			INC_DWORD_STAT(STAT_EDGEHouses_TasksDone);
+			if (AHouseEditor* House = Cast<AHouseEditor>(Target))
+			{
+				OnHouseBuilt.Broadcast(House, Task.Type);
+			}
+		}
+	}
+	while (Tasks.Num() > 0 && FPlatformTime::Seconds() < EndTime);
+
+	if (Tasks.Num() == 0)
+	{
+		UE_LOG(LogTemp, Display, TEXT("~~ House build queue of %s is done: %i tasks in %.2f s."), *GetWorld()->GetName(), NumDone, FPlatformTime::Seconds() - QueueStartTime);
+		OnQueueDrained.Broadcast();
+	}
+}
+
+bool UHouseBuildScheduler::IsTickable() const
+{
+	return Tasks.Num() > 0 && !IsTemplate();
+}
+
+TStatId UHouseBuildScheduler::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UHouseBuildScheduler, STATGROUP_Tickables);
+}
@@ -8,6 +8,8 @@
 #include "HouseEditor/BasePilaster.h"
 #include "HouseEditor/BaseCornice.h"
 #include "HouseEditor/BaseRoof.h"
+#include "HouseEditor/HouseBuildScheduler.h"
+#include "HouseEditor/HouseEditorStats.h"
 
 #include "SegmentEditor/BaseSegment.h"
 #include "SegmentEditor/BaseSegmentDecoration.h"
@@ -20,11 +22,47 @@
 #include "Components/SceneComponent.h"
 #include "Kismet/KismetSystemLibrary.h"
 #include "RuntimeMesh/RMCProviderManager.h"
+#include "RuntimeMesh/EDGERuntimeMeshProvider.h"
+#include "HAL/IConsoleManager.h"
 #include "UObject/UObjectGlobals.h"
+#include "UObject/UObjectIterator.h"
+#include "Hash/CityHash.h"
+#include "EngineUtils.h"
+#include "Misc/DelayedAutoRegister.h"
+#if WITH_EDITOR
+#include "Editor.h"
+#endif
+
+DECLARE_MEMORY_STAT(TEXT("Instanced Elements Memory"), STAT_EDGEHouses_InstancedElementsMemory, STATGROUP_EDGEHouses);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Strips Extracted"), STAT_EDGEHouses_StripsExtracted, STATGROUP_EDGEHouses);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Strips Stamped"), STAT_EDGEHouses_StripsStamped, STATGROUP_EDGEHouses);
+
+static FAutoConsoleCommandWithWorld CmdDeduplicateHouses(
+	TEXT("EDGE.Houses.Deduplicate"),
+	TEXT("Generates mesh data once per unique resolved template in the current world, other houses reuse it. Also runs before a level is saved."),
+	FConsoleCommandWithWorldDelegate::CreateStatic(&AHouseEditor::DeduplicateHouses));
+
+#if WITH_EDITOR
+static FDelayedAutoRegisterHelper DeduplicateOnSave(EDelayedRegisterRunPhase::EndOfEngineInit, []
+{
+	FEditorDelegates::PreSaveWorld.AddLambda([](uint32 SaveFlags, UWorld* World)
+	{
+		AHouseEditor::DeduplicateHouses(World);
+	});
+});
+#endif
+
+static FAutoConsoleCommand CmdDumpHouseMemory(
+	TEXT("EDGE.Houses.DumpMemory"),
+	TEXT("Prints houses and templates using the most memory. Optional argument - how many of each to print (10 by default)."),
+	FConsoleCommandWithArgsDelegate::CreateStatic(&AHouseEditor::DumpMemory));
 
 AHouseEditor::AHouseEditor()
 {
 	PrimaryActorTick.bCanEverTick = false;
+	InstancedElementsBytes = 0;
+	bRuntimeMeshPatched = false;
+	MeshEditCount = 0;
 	Walls.SetNum(4);
 	TemplateLocal.WallPatterns.SetNum(4);
 	TemplateLocal.FireLadderRates.SetNum(4);
@@ -78,6 +116,26 @@ void AHouseEditor::OnConstruction(const FTransform& Transform)
 			// --- New mesh merging
 			if (!GetRMCProvider()->HaveMeshData())
 			{
+				// Mesh data is still read in background - show a box until it arrives
+				TWeakObjectPtr<AHouseEditor> WeakThis(this);
+				const FString RequestedKey = GetMeshCacheKey();
+				if (!bMeshIsDirty && EDGERuntimeProviderManager::RequestSnapshot(this, RequestedKey, [WeakThis, RequestedKey](FEDGEMeshSnapshotPtr Snapshot)
+					{
+						if (WeakThis.IsValid())
+						{
+							WeakThis->OnMeshDataPrefetched(Snapshot, RequestedKey);
+						}
+					}))
+				{
+					BindPlaceholderMesh();
+				}
+				// Game worlds build houses over several frames, a box is shown meanwhile
+				else if (UHouseBuildScheduler* Scheduler = UHouseBuildScheduler::Get(this))
+				{
+					BindPlaceholderMesh();
+					Scheduler->QueueBuild(this);
+				}
+				else
 				//if (!(IsInGameThread() || IsAsyncLoading()))
 				{
 					GenerateMeshData();
@@ -110,7 +168,7 @@ void AHouseEditor::OnConstruction(const FTransform& Transform)
 	{
 		if (GetRMCProvider()->HaveMeshData() && AllSegments.Num() == 0)
 		{
-			GetRuntimeMeshComponent()->Initialize(GetRMCProvider());
+			RequestBindRuntimeMesh();
 		}
 	}
 	else
@@ -120,19 +178,202 @@ void AHouseEditor::OnConstruction(const FTransform& Transform)
 	
 }
 
-void AHouseEditor::ClearHouse(bool bRemoveInstanceMeshes)
+void AHouseEditor::PostLoad()
+{
+	Super::PostLoad();
+
+	// All houses of a level are loaded before the first one is constructed, so their files are read meanwhile
+	if (!HasAnyFlags(RF_ClassDefaultObject | RF_ArchetypeObject) && !bMeshIsDirty)
+	{
+		EDGERuntimeProviderManager::Prefetch(this, { GetMeshCacheKey() });
+	}
+}
+
+// Houses with identical mesh data share one runtime mesh, only transform and material overrides stay per component
+void AHouseEditor::BindRuntimeMesh()
+{
+	URuntimeMeshComponent* Component = GetRuntimeMeshComponent();
+	if (URuntimeMesh* SharedMesh = EDGERuntimeProviderManager::GetSharedMesh(this, *GetMeshCacheKey(), GetRMCProvider()))
+	{
+		if (Component->GetRuntimeMesh() != SharedMesh)
+		{
+			Component->SetRuntimeMesh(SharedMesh);
+		}
+		const FName TemplateKey = *GetMeshCacheKey();
+		if (InstancedTemplateKey != TemplateKey)
+		{
+			RemoveTemplateInstance();
+		}
+		EDGERuntimeProviderManager::AddTemplateInstance(Component, TemplateKey, GetRMCProvider());
+		InstancedTemplateKey = TemplateKey;
+		if (!Component->TransformUpdated.IsBoundToObject(this))
+		{
+			Component->TransformUpdated.AddUObject(this, &AHouseEditor::OnRuntimeMeshTransformUpdated);
+		}
+		UpdateMeshPriority();
+		return;
+	}
+	BindOwnRuntimeMesh(GetRMCProvider());
+	UpdateMeshPriority();
+}
+
+// Mesh of this house's component only
+void AHouseEditor::BindOwnRuntimeMesh(UEDGERuntimeMeshProvider* Provider)
+{
+	URuntimeMeshComponent* Component = GetRuntimeMeshComponent();
+	RemoveTemplateInstance();
+
+	// Initialize would rebuild the shared mesh for every house linked to it
+	if (Component->GetRuntimeMesh() != nullptr && Component->GetRuntimeMesh()->GetOuter() != Component)
+	{
+		Component->SetRuntimeMesh(nullptr);
+	}
+	Component->Initialize(Provider);
+}
+
+// Removed under the key it was added with, the cache key may have changed since
+void AHouseEditor::RemoveTemplateInstance()
+{
+	if (RuntimeMeshComponent != nullptr && !InstancedTemplateKey.IsNone())
+	{
+		EDGERuntimeProviderManager::RemoveTemplateInstance(RuntimeMeshComponent, InstancedTemplateKey);
+	}
+	InstancedTemplateKey = NAME_None;
+}
+
+void AHouseEditor::OnRuntimeMeshTransformUpdated(USceneComponent* UpdatedComponent, EUpdateTransformFlags UpdateTransformFlags, ETeleportType Teleport)
+{
+	if (!InstancedTemplateKey.IsNone())
+	{
+		EDGERuntimeProviderManager::UpdateTemplateInstance(Cast<UPrimitiveComponent>(UpdatedComponent), InstancedTemplateKey);
+	}
+}
+
+// Mesh and collision updates of selected houses go first, then of the ones closest to the view
+float AHouseEditor::GetMeshPriority() const
+{
+	FVector ViewLocation;
+	if (IsSelected())
+	{
+		return MAX_flt;
+	}
+	if (UHouseEditorFunctionLibrary::GetViewLocation(GetWorld(), ViewLocation))
+	{
+		return 1.f / FMath::Max(FVector::Dist(ViewLocation, GetActorLocation()), 1.f);
+	}
+	return 0.f;
+}
+
+void AHouseEditor::UpdateMeshPriority()
+{
+	URuntimeMesh* Mesh = GetRuntimeMeshComponent()->GetRuntimeMesh();
+	if (Mesh == nullptr)
+	{
+		return;
+	}
+
+	// Shared mesh is as urgent as the most urgent of the houses linked to it now, recomputed so a deselected or removed house doesn't keep it up
+	float Priority = GetMeshPriority();
+	if (Mesh->GetOuter() != GetRuntimeMeshComponent())
+	{
+		Mesh->DoForAllLinkedComponents([&Priority](URuntimeMeshComponent* MeshComponent)
+		{
+			if (const AHouseEditor* House = Cast<AHouseEditor>(MeshComponent->GetOwner()))
+			{
+				Priority = FMath::Max(Priority, House->GetMeshPriority());
+			}
+		});
+	}
+	Mesh->SetUpdatePriority(Priority);
+}
+
+// Box of the house bounds, shown until the real mesh is bound. It is cheap, so it is bound right away even in game worlds.
+void AHouseEditor::BindPlaceholderMesh()
+{
+	const FBox Bounds(FVector(0.f, -SegmentWidthInUnits * TemplateLocal.HouseWidth, 0.f),
+					FVector(SegmentWidthInUnits * TemplateLocal.HouseLength, 0.f, GetRealHeight(TemplateLocal.HouseHeight)));
+
+	FRMCSectionData Section;
+	UEDGEMeshUtility::ConvertRawSectionGeometry(UEDGEMeshUtility::MakeBoxSection(Bounds, string(), 0), Section);
+
+	UEDGERuntimeMeshProvider* Placeholder = NewObject<UEDGERuntimeMeshProvider>(this);
+	Placeholder->SetSectionsData({ Section });
+	Placeholder->SetMaterials({ DefaultWallMat });
+	BindOwnRuntimeMesh(Placeholder);
+}
+
+void AHouseEditor::OnMeshDataPrefetched(FEDGEMeshSnapshotPtr Snapshot, const FString& RequestedKey)
+{
+	// Rebuilt while the file was read - own data is newer
+	const FString MeshCacheKey = GetMeshCacheKey();
+	if (GetRMCProvider()->GetTemplateName() == *MeshCacheKey && GetRMCProvider()->HaveMeshData())
+	{
+		return;
+	}
+	// Retemplated meanwhile - the file is of another house now, so it is built as if nothing was found
+	if (RequestedKey != MeshCacheKey)
+	{
+		Snapshot = nullptr;
+	}
+
+	if (Snapshot.IsValid())
+	{
+		RMCProvider = NewObject<UEDGERuntimeMeshProvider>(this);
+		RMCProvider->SetTemplateName(*FString::Printf(TEXT("%s"), *MeshCacheKey));
+		RMCProvider->SetSnapshot(Snapshot);
+		RMCProvider->SetLODSettings(GetLODScreenSizes(), GetLODCastShadows());
+
+		GetHouseNavCollider()->SetRelativeLocation(GetRMCProvider()->GetBoxCenter());
+		GetHouseNavCollider()->SetBoxExtent(GetRMCProvider()->GetBoxRadius());
+	}
+	else if (UHouseBuildScheduler* Scheduler = UHouseBuildScheduler::Get(this))
+	{
+		// File was missing or broken - build it in turn, placeholder stays until then
+		Scheduler->QueueBuild(this);
+		return;
+	}
+	else
+	{
+		// File was missing or broken - build it the usual way
+		GenerateMeshData();
+		ClearHouse();
+	}
+
+	if (GetRMCProvider()->HaveMeshData() && AllSegments.Num() == 0)
+	{
+		RequestBindRuntimeMesh();
+	}
+}
+
+// Binding creates render and collision data, in game worlds it waits for its turn - with a box shown meanwhile, as builds do
+void AHouseEditor::RequestBindRuntimeMesh()
+{
+	if (UHouseBuildScheduler* Scheduler = UHouseBuildScheduler::Get(this))
+	{
+		if (GetRuntimeMeshComponent()->GetRuntimeMesh() == nullptr)
+		{
+			BindPlaceholderMesh();
+		}
+		Scheduler->QueueBind(this);
+		return;
+	}
+	BindRuntimeMesh();
+}
+
+void AHouseEditor::ClearHouse(bool bRemoveInstanceMeshes, bool bKeepRuntimeMesh)
 {
 	if (SavedHouseMeshComponent != nullptr)
 	{
 		SavedHouseMeshComponent->DestroyComponent();
 	}
-	GetRuntimeMeshComponent()->SetRuntimeMesh(nullptr);
+	if (!bKeepRuntimeMesh)
+	{
+		RemoveTemplateInstance();
+		GetRuntimeMeshComponent()->SetRuntimeMesh(nullptr);
+	}
+	// Elements go back to the pool, next build reuses them
 	while (AllCustoms.Num() > 0) {
-		AActor* Element = AllCustoms.Pop();
-		if (Element != nullptr)
-		{
-			Element->Destroy();
-		}
+		UHouseEditorFunctionLibrary::ReleaseElement(AllCustoms.Pop());
 	}
 	while (AllSegments.Num() > 0) {
 		AActor* Element = AllSegments.Pop();
@@ -142,9 +383,9 @@ void AHouseEditor::ClearHouse(bool bRemoveInstanceMeshes)
 			Element->GetAttachedActors(Decorations);
 			for (AActor* Actor : Decorations)
 			{
-				Actor->Destroy();
+				UHouseEditorFunctionLibrary::ReleaseElement(Actor);
 			}
-			Element->Destroy();
+			UHouseEditorFunctionLibrary::ReleaseElement(Element);
 		}
 	}
 	while (WallAnchors.Num() > 0) {
@@ -155,7 +396,8 @@ void AHouseEditor::ClearHouse(bool bRemoveInstanceMeshes)
 		}
 	}
 	if (RoofActor != nullptr) {
-		RoofActor->Destroy();
+		UHouseEditorFunctionLibrary::ReleaseElement(RoofActor);
+		RoofActor = nullptr;
 	}
 	if (bRemoveInstanceMeshes)
 	{
@@ -163,9 +405,56 @@ void AHouseEditor::ClearHouse(bool bRemoveInstanceMeshes)
 		{
 			InstancedElements.Pop()->DestroyComponent();
 		}
+		UpdateInstancedElementsBytes();
 	}
 }
 
+// Segments of one wall in its anchor space, with the decoration picked for each socket (null for none). Both builds lay walls out here,
+// so a house and its virtual build get the same segments and draw the same random values.
+bool AHouseEditor::LayOutWallSegments(const FCompiledPattern& Pattern, int WallIndex, int WallLength, const TArray<int>& LaddersHIndexes, TArray<FWallSegmentLayout>& OutSegments) const
+{
+	// Weight ids once per wall, picks are then lookups by two ids. Ids of a pattern from before a registry rebuild are gone with it, its rows go by content.
+	const bool bCurrentPattern = UHouseEditorFunctionLibrary::IsCompiledPatternCurrent(Pattern);
+	const int32 EmptyWeightsId = UHouseEditorFunctionLibrary::GetDecorationWeightsId(FSegmentDecorationsData());
+	const int32 WallWeightsId = UHouseEditorFunctionLibrary::GetDecorationWeightsId(TemplateLocal.GlobalDecorationWeights[WallIndex]);
+
+	for (int vi = 0; vi < TemplateLocal.HouseHeight; vi++)
+	{
+		const FCompiledPatternLine& Line = Pattern.Lines[Pattern.GetLineIndex(vi)];
+		// Ground floor may ignore global weights
+		const int32 FloorWeightsId = (vi == 0 && TemplateLocal.bGlobalDecorationsIgnoreGroundFloor) ? EmptyWeightsId : WallWeightsId;
+
+		for (int SegmentIdx = Line.FirstSegment, Position = 0; Position < WallLength; SegmentIdx = Pattern.Segments[SegmentIdx].Next) {
+			const FCompiledPatternSegment& CompiledSegment = Pattern.Segments[SegmentIdx];
+			if (CompiledSegment.Class == NULL) {
+				UE_LOG(LogTemp, Warning, TEXT("Segment '%s' has no class - aborting construction."), *CompiledSegment.Source.SegmentName.ToString());
+				return false;
+			}
+
+			FWallSegmentLayout& Layout = OutSegments.AddDefaulted_GetRef();
+			Layout.Class = CompiledSegment.Class;
+			Layout.Floor = vi;
+			Layout.Transform = FTransform(FVector(SegmentWidthInUnits * Position, 0, GetRealHeight(vi)));
+
+			// No decorations behind fire ladders
+			if (LaddersHIndexes.Contains(Position) == false || vi == 0) {
+				const TArray<FName>& Sockets = CompiledSegment.Sockets;
+				const int32 GlobalWeightsId = CompiledSegment.Source.bIgnoreGlobalDecorations ? EmptyWeightsId : FloorWeightsId;
+				for (int SocketIndex = 0; SocketIndex < Sockets.Num(); SocketIndex++)
+				{
+					float RValue = UHouseEditorFunctionLibrary::GetDecorationRandom(TemplateLocal.RandomSeed, WallIndex, vi, Position, SocketIndex);
+					const int32 SegmentWeightsId = bCurrentPattern ? CompiledSegment.SocketWeightsIds[SocketIndex]
+						: UHouseEditorFunctionLibrary::GetSegmentDecorationWeightsId(CompiledSegment.Source, Sockets[SocketIndex]);
+					Layout.Decorations.Emplace(Sockets[SocketIndex], UHouseEditorFunctionLibrary::PickDecorationClass(SegmentWeightsId, GlobalWeightsId, RValue));
+				}
+			}
+
+			Position += CompiledSegment.Size;
+		}
+	}
+	return true;
+}
+
 bool AHouseEditor::BuildHouse() {
 	ClearHouse();
 
@@ -199,12 +488,7 @@ bool AHouseEditor::BuildHouse() {
 	}
 
 	// Random preparations (for decorations)
-	if (TemplateLocal.RandomSeed <= 0)
-	{
-		TemplateLocal.RandomSeed = abs(rand());
-	}
-	srand(1);		// Reset any previous calls
-	srand(static_cast<unsigned>(TemplateLocal.RandomSeed));		// MMMM?????
+	FinalizeRandomSeed();
 
 	// Walls
 
@@ -216,13 +500,13 @@ bool AHouseEditor::BuildHouse() {
 	}
 	
 	for (int WallIndex = 0; WallIndex < Walls.Num(); WallIndex++) {
-		FPatternData* Data = PatternDataTable->FindRow<FPatternData>(TemplateLocal.WallPatterns[WallIndex], FString());
-		if (Data == NULL) {
-			UE_LOG(LogTemp, Warning, TEXT("Wall pattern #%i - '%s' was not found. Construction aborted."), WallIndex, *TemplateLocal.WallPatterns[WallIndex].ToString());
+		// Held for the whole wall, element construction may rebuild the registry
+		const TSharedPtr<const FCompiledPattern> Pattern = UHouseEditorFunctionLibrary::FindCompiledPattern(TemplateLocal.WallPatterns[WallIndex]);
+		if (!Pattern.IsValid() || !Pattern->bValid) {
+			UE_LOG(LogTemp, Warning, TEXT("Wall pattern #%i - '%s' was not found or has empty lines. Construction aborted."), WallIndex, *TemplateLocal.WallPatterns[WallIndex].ToString());
 			ClearHouse();
 			return false;
 		}
-		Walls[WallIndex] = *Data;
 
 		int WallLength = (WallIndex % 2 == 0) ? TemplateLocal.HouseLength : TemplateLocal.HouseWidth; // works for now - couse using only "box"-houses
 
@@ -233,9 +517,9 @@ bool AHouseEditor::BuildHouse() {
 			ABaseFireLadder* NewLadder;
 			if (TemplateLocal.FireLadderRates[WallIndex] == 1) {
 				int SegmentIndex = FMath::Clamp(TemplateLocal.FireLadderOffsets[WallIndex], 0, WallLength - 4);
-				NewLadder = GetWorld()->SpawnActorDeferred<ABaseFireLadder>(TemplateLocal.FireLadderClass, FTransform(), this);
+				NewLadder = Cast<ABaseFireLadder>(UHouseEditorFunctionLibrary::AcquireElement(GetWorld(), TemplateLocal.FireLadderClass, this));
 				NewLadder->ladderHeight = TemplateLocal.HouseHeight - 1;
-				NewLadder->FinishSpawning(FTransform(FVector(SegmentWidthInUnits * (1 + SegmentIndex), 0, GetRealHeight())));
+				UHouseEditorFunctionLibrary::FinishElement(NewLadder, FTransform(FVector(SegmentWidthInUnits * (1 + SegmentIndex), 0, GetRealHeight())));
 				NewLadder->AttachToComponent(WallAnchors[WallIndex], FAttachmentTransformRules::KeepRelativeTransform);
 				AllCustoms.Add(NewLadder);
 				LaddersHIndexes.Add(SegmentIndex+1);
@@ -244,9 +528,9 @@ bool AHouseEditor::BuildHouse() {
 			else {
 				for (int SegmentIndex = 1; SegmentIndex < WallLength - 2; SegmentIndex++) {
 					if ((SegmentIndex - TemplateLocal.FireLadderOffsets[WallIndex]) % TemplateLocal.FireLadderRates[WallIndex] == 0) {
-						NewLadder = GetWorld()->SpawnActorDeferred<ABaseFireLadder>(TemplateLocal.FireLadderClass, FTransform(), this);
+						NewLadder = Cast<ABaseFireLadder>(UHouseEditorFunctionLibrary::AcquireElement(GetWorld(), TemplateLocal.FireLadderClass, this));
 						NewLadder->ladderHeight = TemplateLocal.HouseHeight - 1;
-						NewLadder->FinishSpawning(FTransform(FVector(SegmentWidthInUnits * SegmentIndex, 0, GetRealHeight())));
+						UHouseEditorFunctionLibrary::FinishElement(NewLadder, FTransform(FVector(SegmentWidthInUnits * SegmentIndex, 0, GetRealHeight())));
 						NewLadder->AttachToComponent(WallAnchors[WallIndex], FAttachmentTransformRules::KeepRelativeTransform);
 						AllCustoms.Add(NewLadder);
 						LaddersHIndexes.Add(SegmentIndex);
@@ -258,98 +542,54 @@ bool AHouseEditor::BuildHouse() {
 		
 		// Segments
 
-		for (int vi = 0; vi < TemplateLocal.HouseHeight; vi++)
-		{
-			int OffsetH = 0;
-			int LineIndex;
-			if (Data->bRepeatPattern) {
-				LineIndex = vi % Walls[WallIndex].Lines.Num();
+		TArray<FWallSegmentLayout> SegmentLayouts;
+		if (!LayOutWallSegments(*Pattern, WallIndex, WallLength, LaddersHIndexes, SegmentLayouts)) {
+			ClearHouse();
+			return false;
+		}
+
+		for (const FWallSegmentLayout& Layout : SegmentLayouts) {
+			ABaseSegment* NewActor = Cast<ABaseSegment>(UHouseEditorFunctionLibrary::AcquireElement(GetWorld(), Layout.Class, this));
+			if (NewActor == NULL) {
+				UE_LOG(LogTemp, Warning, TEXT("Actor was not created - aborting construction."));
+				ClearHouse();
+				return false;
 			}
-			else {
-				LineIndex = (vi < Walls[WallIndex].Lines.Num()) ? vi : Walls[WallIndex].Lines.Num() - 1;
+			UHouseEditorFunctionLibrary::FinishElement(NewActor, Layout.Transform);
+			NewActor->AttachToComponent(WallAnchors[WallIndex], FAttachmentTransformRules::KeepRelativeTransform);
+
+			//TArray<TEnumAsByte<EMaterialSlot>> keys;
+			//materialOverrides.GetKeys(keys);
+			//for (int i = 0; i < keys.Num(); i++) {
+			//	newActor->SetMaterialByName(keys[i], materialOverrides[keys[i]]);
+			//}
+
+			// temp single mat override ^
+			if (TemplateLocal.WallMatOverride != nullptr) {
+				NewActor->SetMaterialByName(Wall, TemplateLocal.WallMatOverride);
 			}
-			FPatternLine Line = Walls[WallIndex].Lines[LineIndex];
-			
-			for (int hi = 0; hi + OffsetH < WallLength; hi++) {
-				int SegmentHIndex;
-				if (Line.bRepeatLine) {
-					SegmentHIndex = hi % Line.Segments.Num();
-				}
-				else {
-					SegmentHIndex = (hi < Line.Segments.Num()) ? hi : Line.Segments.Num() - 1;
-				}
 
-				ABaseSegment* NewActor = GetWorld()->SpawnActor<ABaseSegment>(UHouseEditorFunctionLibrary::GetSegmentClassByFName(Line.Segments[SegmentHIndex].SegmentName), FVector(SegmentWidthInUnits * (hi + OffsetH), 0, GetRealHeight(vi)), FRotator(0));
-				if (NewActor == NULL) {
-					UE_LOG(LogTemp, Warning, TEXT("Actor was not created - aborting construction."));
-					ClearHouse();
-					return false;
-				}
-				NewActor->AttachToComponent(WallAnchors[WallIndex], FAttachmentTransformRules::KeepRelativeTransform);
+			AllSegments.Add(NewActor);
 
-				//TArray<TEnumAsByte<EMaterialSlot>> keys;
-				//materialOverrides.GetKeys(keys);
-				//for (int i = 0; i < keys.Num(); i++) {
-				//	newActor->SetMaterialByName(keys[i], materialOverrides[keys[i]]);
-				//}
+			// Segment decorations
 
-				// temp single mat override ^
-				if (TemplateLocal.WallMatOverride != nullptr) {
-					NewActor->SetMaterialByName(Wall, TemplateLocal.WallMatOverride);
+			const TArray<USceneComponent*> Sockets = NewActor->GetDecorationSockets();
+			const TArray<FName> SocketNames = NewActor->GetDecorationSocketsNames();
+			for (const TPair<FName, TSubclassOf<ABaseSegmentDecoration>>& Decoration : Layout.Decorations)
+			{
+				const int SocketIndex = SocketNames.IndexOfByKey(Decoration.Key);
+				if (Decoration.Value == NULL || !Sockets.IsValidIndex(SocketIndex) || Sockets[SocketIndex] == nullptr)
+				{
+					continue;
 				}
-
-				AllSegments.Add(NewActor);
-
-				// Segment decorations
-
-				if (LaddersHIndexes.Contains(hi + OffsetH) == false || vi == 0) {
-					TArray<USceneComponent*> Sockets = NewActor->GetDecorationSockets();
-
-					if (Sockets.Num() > 0)
-					{
-						for (USceneComponent* Socket : Sockets)
-						{
-							float RValue = static_cast<float>(rand()) / static_cast<float>(RAND_MAX);
-							float Threshold = 0.f;
-
-							TMap<FName, float> WeightsMap;
-							if (vi == 0 && TemplateLocal.bGlobalDecorationsIgnoreGroundFloor)
-							{
-								const FSegmentDecorationsData EmptyData;
-								WeightsMap = UHouseEditorFunctionLibrary::GetNormalizedDecorationWeights(Line.Segments[SegmentHIndex], Socket->GetFName(), EmptyData);
-							}
-							else
-							{
-								WeightsMap = UHouseEditorFunctionLibrary::GetNormalizedDecorationWeights(Line.Segments[SegmentHIndex], Socket->GetFName(), TemplateLocal.GlobalDecorationWeights[WallIndex]);
-							}
-					
-							TSubclassOf<ABaseSegmentDecoration> DecorationClass;
-							TArray<FName> Names;
-							WeightsMap.GenerateKeyArray(Names);
-		
-							for (FName Name : Names)
-							{
-								Threshold += WeightsMap.FindRef(Name);
-								if (RValue <= Threshold)
-								{
-									DecorationClass = UHouseEditorFunctionLibrary::GetSegmentDecorationClassByFName(Name);
-									break;
-								}
-							}
-							if (DecorationClass != NULL)
-							{
-								ABaseSegmentDecoration* NewDecoration = GetWorld()->SpawnActor<ABaseSegmentDecoration>(DecorationClass, FVector(0.f), FRotator(0.f));
-								if (NewDecoration == NULL)
-								{
-									UE_LOG(LogTemp, Warning, TEXT("Decoration was not created! Process continued..."));
-								}
-								NewDecoration->AttachToComponent(Socket, FAttachmentTransformRules::KeepRelativeTransform);
-							}
-						}
-					}
+				ABaseSegmentDecoration* NewDecoration = Cast<ABaseSegmentDecoration>(UHouseEditorFunctionLibrary::AcquireElement(GetWorld(), Decoration.Value, this));
+				if (NewDecoration == NULL)
+				{
+					UE_LOG(LogTemp, Warning, TEXT("Decoration was not created! Process continued..."));
+					continue;
 				}
-				
-				OffsetH += NewActor->GetSegmentSize() - 1;
+				UHouseEditorFunctionLibrary::FinishElement(NewDecoration, FTransform());
+				NewDecoration->AttachToComponent(Sockets[SocketIndex], FAttachmentTransformRules::KeepRelativeTransform);
 			}
 		}
 
@@ -357,12 +597,11 @@ bool AHouseEditor::BuildHouse() {
 		// Quoins
 
 		if (TemplateLocal.QuoinClass != NULL) {
-			ABaseQuoin* NewQuoin = GetWorld()->SpawnActorDeferred<ABaseQuoin>(TemplateLocal.QuoinClass, FTransform(), this);
+			ABaseQuoin* NewQuoin = Cast<ABaseQuoin>(UHouseEditorFunctionLibrary::AcquireElement(GetWorld(), TemplateLocal.QuoinClass, this));
 			NewQuoin->quoinHeight = TemplateLocal.HouseHeight;
-			if (TemplateLocal.BottomCorniceClass != NULL) {
-				NewQuoin->corniceOffset = CorniceHeightOffset;
-			}
-			NewQuoin->FinishSpawning(FTransform());
+			// Always set - a pooled quoin still has the offset of its last house
+			NewQuoin->corniceOffset = (TemplateLocal.BottomCorniceClass != NULL) ? CorniceHeightOffset : TemplateLocal.QuoinClass->GetDefaultObject<ABaseQuoin>()->corniceOffset;
+			UHouseEditorFunctionLibrary::FinishElement(NewQuoin, FTransform());
 			NewQuoin->AttachToComponent(WallAnchors[WallIndex], FAttachmentTransformRules::KeepRelativeTransform);
 			AllCustoms.Add(NewQuoin);
 		}
@@ -372,12 +611,11 @@ bool AHouseEditor::BuildHouse() {
 		if (TemplateLocal.PilasterClass != NULL && TemplateLocal.PilasterRates[WallIndex] > 0) {
 			for (int SegmentNum = 1; SegmentNum < WallLength; SegmentNum++) {
 				if ((SegmentNum - TemplateLocal.PilasterOffsets[WallIndex]) % TemplateLocal.PilasterRates[WallIndex] == 0) {
-					ABasePilaster*  NewPilaster = GetWorld()->SpawnActorDeferred<ABasePilaster>(TemplateLocal.PilasterClass, FTransform(), this);
+					ABasePilaster*  NewPilaster = Cast<ABasePilaster>(UHouseEditorFunctionLibrary::AcquireElement(GetWorld(), TemplateLocal.PilasterClass, this));
 					NewPilaster->pilasterHeight = (TemplateLocal.bPilasterIgnoreGroundFloor) ? TemplateLocal.HouseHeight - 1 : TemplateLocal.HouseHeight;
-					if (TemplateLocal.BottomCorniceClass != NULL && !TemplateLocal.bPilasterIgnoreGroundFloor) {
-						NewPilaster->corniceOffset = CorniceHeightOffset;
-					}
-					NewPilaster->FinishSpawning(FTransform(FVector(SegmentWidthInUnits * SegmentNum, 0, (TemplateLocal.bPilasterIgnoreGroundFloor) ? GetRealHeight() : 0)));
+					NewPilaster->corniceOffset = (TemplateLocal.BottomCorniceClass != NULL && !TemplateLocal.bPilasterIgnoreGroundFloor)
+						? CorniceHeightOffset : TemplateLocal.PilasterClass->GetDefaultObject<ABasePilaster>()->corniceOffset;
+					UHouseEditorFunctionLibrary::FinishElement(NewPilaster, FTransform(FVector(SegmentWidthInUnits * SegmentNum, 0, (TemplateLocal.bPilasterIgnoreGroundFloor) ? GetRealHeight() : 0)));
 					NewPilaster->AttachToComponent(WallAnchors[WallIndex], FAttachmentTransformRules::KeepRelativeTransform);
 					AllCustoms.Add(NewPilaster);
 				}
@@ -387,16 +625,16 @@ bool AHouseEditor::BuildHouse() {
 		// Cornices
 
 		if (TemplateLocal.BottomCorniceClass != NULL) {
-			ABaseCornice* NewCornice = GetWorld()->SpawnActorDeferred<ABaseCornice>(TemplateLocal.BottomCorniceClass, FTransform(), this);
+			ABaseCornice* NewCornice = Cast<ABaseCornice>(UHouseEditorFunctionLibrary::AcquireElement(GetWorld(), TemplateLocal.BottomCorniceClass, this));
 			NewCornice->corniceLength = WallLength;
-			NewCornice->FinishSpawning(FTransform(FVector(0, 0, SegmentHeightInUnits)));
+			UHouseEditorFunctionLibrary::FinishElement(NewCornice, FTransform(FVector(0, 0, SegmentHeightInUnits)));
 			NewCornice->AttachToComponent(WallAnchors[WallIndex], FAttachmentTransformRules::KeepRelativeTransform);
 			AllCustoms.Add(NewCornice);
 		}
 		if (TemplateLocal.TopCorniceClass != NULL) {
-			ABaseCornice* NewCornice = GetWorld()->SpawnActorDeferred<ABaseCornice>(TemplateLocal.TopCorniceClass, FTransform(), this);
+			ABaseCornice* NewCornice = Cast<ABaseCornice>(UHouseEditorFunctionLibrary::AcquireElement(GetWorld(), TemplateLocal.TopCorniceClass, this));
 			NewCornice->corniceLength = WallLength;
-			NewCornice->FinishSpawning(FTransform(FVector(0, 0, GetRealHeight(TemplateLocal.HouseHeight))));
+			UHouseEditorFunctionLibrary::FinishElement(NewCornice, FTransform(FVector(0, 0, GetRealHeight(TemplateLocal.HouseHeight))));
 			NewCornice->AttachToComponent(WallAnchors[WallIndex], FAttachmentTransformRules::KeepRelativeTransform);
 			AllCustoms.Add(NewCornice);
 		}
@@ -412,10 +650,10 @@ bool AHouseEditor::BuildHouse() {
 		TemplateLocal.RoofClass = DefaultRoofClass;
 	}
 	float ExtraHeight = (TemplateLocal.TopCorniceClass != NULL) ? CorniceHeightOffset - 0.3f : 0;
-	RoofActor = GetWorld()->SpawnActorDeferred<ABaseRoof>(TemplateLocal.RoofClass, FTransform(), this);
+	RoofActor = Cast<ABaseRoof>(UHouseEditorFunctionLibrary::AcquireElement(GetWorld(), TemplateLocal.RoofClass, this));
 	RoofActor->RoofLength = TemplateLocal.HouseLength;
 	RoofActor->RoofWidth = TemplateLocal.HouseWidth;
-	RoofActor->FinishSpawning(FTransform(FVector(0, 0, GetRealHeight(TemplateLocal.HouseHeight) + ExtraHeight)));
+	UHouseEditorFunctionLibrary::FinishElement(RoofActor, FTransform(FVector(0, 0, GetRealHeight(TemplateLocal.HouseHeight) + ExtraHeight)));
 	RoofActor->AttachToComponent(WallAnchors[0], FAttachmentTransformRules::KeepRelativeTransform);
 
 	if (TemplateLocal.WallMatOverride != nullptr)
@@ -426,8 +664,180 @@ bool AHouseEditor::BuildHouse() {
 	return true;
 }
 
+// Same layout as BuildHouse, but read from class defaults into a flat list of meshes in house space - no actors are spawned
+bool AHouseEditor::BuildVirtualHouse(TArray<FHouseMeshPlacement>& OutPlacements)
+{
+	OutPlacements.Reset();
+	int ElementIndex = 0;
+
+	// Adds meshes of one element placed at Transform - template meshes of its class and the ones it lays out itself. Floor is set for per-floor elements only.
+	const auto AddElement = [&OutPlacements, &ElementIndex](UClass* ElementClass, const TArray<FHouseMeshPlacement>& Layout, const FTransform& Transform, int WallIndex, int Floor)
+	{
+		const int FirstIndex = OutPlacements.Num();
+		OutPlacements.Append(UHouseEditorFunctionLibrary::GetClassMetadata(ElementClass).Meshes);
+		OutPlacements.Append(Layout);
+		for (int Idx = FirstIndex; Idx < OutPlacements.Num(); Idx++)
+		{
+			OutPlacements[Idx].Transform = OutPlacements[Idx].Transform * Transform;
+			OutPlacements[Idx].WallIndex = WallIndex;
+			OutPlacements[Idx].Floor = Floor;
+			OutPlacements[Idx].ElementIndex = ElementIndex;
+		}
+		ElementIndex++;
+		return FirstIndex;
+	};
+
+	// works for now - cause using only "box"-houses, must be reworked later
+	TArray<FTransform> AnchorTransforms;
+	for (int WallIndex = 0; WallIndex < 4; WallIndex++)
+	{
+		AnchorTransforms.Add(GetPartOrigin(WallIndex, INDEX_NONE));
+	}
+
+	// Random preparations (for decorations). Values are addressed by position, so BuildHouse gives the same decorations
+	FinalizeRandomSeed();
+
+	// Walls
+
+	UDataTable* PatternDataTable = UHouseEditorFunctionLibrary::GetPatternDataTable();
+	if (PatternDataTable == NULL)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Data table is not valid. Can't build house. Construction aborted."));
+		return false;
+	}
+
+	for (int WallIndex = 0; WallIndex < Walls.Num(); WallIndex++) {
+		const TSharedPtr<const FCompiledPattern> Pattern = UHouseEditorFunctionLibrary::FindCompiledPattern(TemplateLocal.WallPatterns[WallIndex]);
+		if (!Pattern.IsValid() || !Pattern->bValid) {
+			UE_LOG(LogTemp, Warning, TEXT("Wall pattern #%i - '%s' was not found or has empty lines. Construction aborted."), WallIndex, *TemplateLocal.WallPatterns[WallIndex].ToString());
+			OutPlacements.Reset();
+			return false;
+		}
+		const FTransform& AnchorTransform = AnchorTransforms[WallIndex];
+
+		int WallLength = (WallIndex % 2 == 0) ? TemplateLocal.HouseLength : TemplateLocal.HouseWidth; // works for now - couse using only "box"-houses
+
+		// FireLadders
+
+		TArray<int> LaddersHIndexes;
+		if (TemplateLocal.HouseHeight > 1 && TemplateLocal.FireLadderClass != NULL && TemplateLocal.FireLadderRates[WallIndex] > 0 && WallLength >= 4) {
+			const ABaseFireLadder* LadderDefaults = TemplateLocal.FireLadderClass->GetDefaultObject<ABaseFireLadder>();
+			const TArray<FHouseMeshPlacement> LadderLayout = LadderDefaults->GetPlacements(TemplateLocal.HouseHeight - 1);
+			if (TemplateLocal.FireLadderRates[WallIndex] == 1) {
+				int SegmentIndex = FMath::Clamp(TemplateLocal.FireLadderOffsets[WallIndex], 0, WallLength - 4);
+				AddElement(TemplateLocal.FireLadderClass, LadderLayout, FTransform(FVector(SegmentWidthInUnits * (1 + SegmentIndex), 0, GetRealHeight())) * AnchorTransform, WallIndex, INDEX_NONE);
+				LaddersHIndexes.Add(SegmentIndex+1);
+				LaddersHIndexes.Add(SegmentIndex+2);
+			}
+			else {
+				for (int SegmentIndex = 1; SegmentIndex < WallLength - 2; SegmentIndex++) {
+					if ((SegmentIndex - TemplateLocal.FireLadderOffsets[WallIndex]) % TemplateLocal.FireLadderRates[WallIndex] == 0) {
+						AddElement(TemplateLocal.FireLadderClass, LadderLayout, FTransform(FVector(SegmentWidthInUnits * SegmentIndex, 0, GetRealHeight())) * AnchorTransform, WallIndex, INDEX_NONE);
+						LaddersHIndexes.Add(SegmentIndex);
+						LaddersHIndexes.Add(SegmentIndex+1);
+					}
+				}
+			}
+		}
+
+		// Segments
+
+		TArray<FWallSegmentLayout> SegmentLayouts;
+		if (!LayOutWallSegments(*Pattern, WallIndex, WallLength, LaddersHIndexes, SegmentLayouts)) {
+			OutPlacements.Reset();
+			return false;
+		}
+
+		for (const FWallSegmentLayout& Layout : SegmentLayouts) {
+			const FTransform SegmentTransform = Layout.Transform * AnchorTransform;
+			const int FirstIndex = AddElement(Layout.Class, {}, SegmentTransform, WallIndex, Layout.Floor);
+
+			// temp single mat override
+			if (TemplateLocal.WallMatOverride != nullptr) {
+				for (int Idx = FirstIndex; Idx < OutPlacements.Num(); Idx++)
+				{
+					UHouseEditorFunctionLibrary::SetPlacementMaterialByName(OutPlacements[Idx], FName("Wall"), TemplateLocal.WallMatOverride);
+				}
+			}
+
+			// Segment decorations
+
+			for (const TPair<FName, TSubclassOf<ABaseSegmentDecoration>>& Decoration : Layout.Decorations)
+			{
+				// Copied - adding decoration classes to the metadata cache may move it
+				const FTransform* SocketTransformPtr = UHouseEditorFunctionLibrary::GetClassMetadata(Layout.Class).SceneTransforms.Find(Decoration.Key);
+				if (Decoration.Value == NULL || SocketTransformPtr == nullptr)
+				{
+					continue;
+				}
+				const FTransform SocketTransform = *SocketTransformPtr;
+				AddElement(Decoration.Value, {}, SocketTransform * SegmentTransform, WallIndex, Layout.Floor);
+			}
+		}
+
+		// Quoins
+
+		if (TemplateLocal.QuoinClass != NULL) {
+			const float QuoinCorniceOffset = (TemplateLocal.BottomCorniceClass != NULL) ? CorniceHeightOffset : TemplateLocal.QuoinClass->GetDefaultObject<ABaseQuoin>()->corniceOffset;
+			AddElement(TemplateLocal.QuoinClass, TemplateLocal.QuoinClass->GetDefaultObject<ABaseQuoin>()->GetPlacements(TemplateLocal.HouseHeight, QuoinCorniceOffset), AnchorTransform, WallIndex, INDEX_NONE);
+		}
+
+		// Pilasters
+
+		if (TemplateLocal.PilasterClass != NULL && TemplateLocal.PilasterRates[WallIndex] > 0) {
+			const ABasePilaster* PilasterDefaults = TemplateLocal.PilasterClass->GetDefaultObject<ABasePilaster>();
+			const int PilasterHeight = (TemplateLocal.bPilasterIgnoreGroundFloor) ? TemplateLocal.HouseHeight - 1 : TemplateLocal.HouseHeight;
+			const float PilasterCorniceOffset = (TemplateLocal.BottomCorniceClass != NULL && !TemplateLocal.bPilasterIgnoreGroundFloor) ? CorniceHeightOffset : PilasterDefaults->corniceOffset;
+			const TArray<FHouseMeshPlacement> PilasterLayout = PilasterDefaults->GetPlacements(PilasterHeight, PilasterCorniceOffset);
+			for (int SegmentNum = 1; SegmentNum < WallLength; SegmentNum++) {
+				if ((SegmentNum - TemplateLocal.PilasterOffsets[WallIndex]) % TemplateLocal.PilasterRates[WallIndex] == 0) {
+					AddElement(TemplateLocal.PilasterClass, PilasterLayout, FTransform(FVector(SegmentWidthInUnits * SegmentNum, 0, (TemplateLocal.bPilasterIgnoreGroundFloor) ? GetRealHeight() : 0)) * AnchorTransform, WallIndex, INDEX_NONE);
+				}
+			}
+		}
+
+		// Cornices
+
+		if (TemplateLocal.BottomCorniceClass != NULL) {
+			AddElement(TemplateLocal.BottomCorniceClass, TemplateLocal.BottomCorniceClass->GetDefaultObject<ABaseCornice>()->GetPlacements(WallLength), FTransform(FVector(0, 0, SegmentHeightInUnits)) * AnchorTransform, WallIndex, INDEX_NONE);
+		}
+		if (TemplateLocal.TopCorniceClass != NULL) {
+			AddElement(TemplateLocal.TopCorniceClass, TemplateLocal.TopCorniceClass->GetDefaultObject<ABaseCornice>()->GetPlacements(WallLength), FTransform(FVector(0, 0, GetRealHeight(TemplateLocal.HouseHeight))) * AnchorTransform, WallIndex, INDEX_NONE);
+		}
+	}
+
+	// Roof
+
+	if (TemplateLocal.RoofClass == nullptr) {
+		if (DefaultRoofClass == nullptr)
+		{
+			UE_LOG(LogTemp, Warning, TEXT("No Default Room Class found. Please check Edge House Constructor plugin settings."))
+		}
+		TemplateLocal.RoofClass = DefaultRoofClass;
+	}
+	if (TemplateLocal.RoofClass != nullptr)
+	{
+		float ExtraHeight = (TemplateLocal.TopCorniceClass != NULL) ? CorniceHeightOffset - 0.3f : 0;
+		const TArray<FHouseMeshPlacement> RoofLayout = TemplateLocal.RoofClass->GetDefaultObject<ABaseRoof>()->GetPlacements(TemplateLocal.HouseLength, TemplateLocal.HouseWidth);
+		const int FirstIndex = AddElement(TemplateLocal.RoofClass, RoofLayout, FTransform(FVector(0, 0, GetRealHeight(TemplateLocal.HouseHeight) + ExtraHeight)) * AnchorTransforms[0], INDEX_NONE, INDEX_NONE);
+
+		if (TemplateLocal.WallMatOverride != nullptr)
+		{
+			for (int Idx = FirstIndex; Idx < OutPlacements.Num(); Idx++)
+			{
+				UHouseEditorFunctionLibrary::SetPlacementMaterialByName(OutPlacements[Idx], FName("Wall"), TemplateLocal.WallMatOverride);
+			}
+		}
+	}
+
+	// Layouts may leave empty slots (e.g. roof lines without meshes)
+	OutPlacements.RemoveAll([](const FHouseMeshPlacement& Placement) { return Placement.Mesh == nullptr; });
+	return true;
+}
+
 bool AHouseEditor::ReadTemplate()
 {
+	MeshEditCount++;
 	if (HouseTemplateName != NAME_None)
 	{
 		UDataTable* HouseTemplateTable = UHouseEditorFunctionLibrary::GetHouseParamsTemplateDataTable();
@@ -436,7 +846,7 @@ bool AHouseEditor::ReadTemplate()
 			UE_LOG(LogTemp, Warning, TEXT("No House Params Template Data Table availavle. Aborting parameters transfer."))
 			return false;
 		}
-		FHouseParamsTemplate* MainTemplate = HouseTemplateTable->FindRow<FHouseParamsTemplate>(HouseTemplateName, FString());
+		const FHouseParamsTemplate* MainTemplate = UHouseEditorFunctionLibrary::FindHouseTemplate(HouseTemplateName);
 		if (MainTemplate == nullptr)
 		{
 			UE_LOG(LogTemp, Warning, TEXT("Aborting parameters transfer."))
@@ -465,6 +875,8 @@ bool AHouseEditor::ReadTemplate()
 		TemplateLocal.bGlobalDecorationsIgnoreGroundFloor = (TemplateOverride.bOverGlobalDecorationsIgnoreGroundFloor)
 												? TemplateOverride.bGlobalDecorationsIgnoreGroundFloor : MainTemplate->bGlobalDecorationsIgnoreGroundFloor;
 		TemplateLocal.MergedMesh = (TemplateOverride.bOverMergedMesh) ? TemplateOverride.MergedMesh : MainTemplate->MergedMesh;
+		TemplateLocal.LODScreenSizes = MainTemplate->LODScreenSizes;
+		TemplateLocal.LODCastShadows = MainTemplate->LODCastShadows;
 
 		TemplateLocal.RandomSeed = MainTemplate->RandomSeed;
 		
@@ -503,6 +915,7 @@ void AHouseEditor::SaveTemplate()
 	// ---
 	
 	bMeshIsDirty = true;
+	MeshEditCount++;
 	
 	HouseTemplateTable->AddRow(HouseTemplateName, TemplateLocal);
 
@@ -522,7 +935,7 @@ void AHouseEditor::SaveTemplateOverride()
 		UE_LOG(LogTemp, Warning, TEXT("No House Params Template Data Table availavle. Aborting parameters transfer."))
 		return;
 	}
-	FHouseParamsTemplate* MainTemplate = HouseTemplateTable->FindRow<FHouseParamsTemplate>(HouseTemplateName, FString());
+	const FHouseParamsTemplate* MainTemplate = UHouseEditorFunctionLibrary::FindHouseTemplate(HouseTemplateName);
 	if (MainTemplate == nullptr)
 	{
 		return;
@@ -629,10 +1042,11 @@ void AHouseEditor::SaveTemplateOverride()
 									|| TemplateOverride.bOverPilasterIgnoreGroundFloor || TemplateOverride.bOverGlobalDecorationWeights || TemplateOverride.bOverGlobalDecorationsIgnoreGroundFloor;
 
 	bMeshIsDirty = true;
+	MeshEditCount++;
 	
 	if (TemplateOverride.bOverMergedMesh == true)
 	{
-		const FString MeshName = GetLevel()->GetName() + "_" + GetName();
+		const FString MeshName = GetMeshCacheKey();
 		// --- Old mesh merging
 		// CreateMergedMesh(MeshName);
 		// TemplateOverride.MergedMesh = TemplateLocal.MergedMesh;
@@ -687,28 +1101,33 @@ void AHouseEditor::RebuildWithRMC()
 		return;
 	}
 
+	bool bPatched = false;
 	if (!GetRMCProvider()->HaveMeshData() || bMeshIsDirty)
 	{
 		GenerateMeshData();
+		bPatched = bRuntimeMeshPatched;
 	}
 
-	ClearHouse();
+	// Patched mesh already shows the new data
+	ClearHouse(true, bPatched);
+	if (bPatched)
+	{
+		UpdateMeshPriority();
+	}
 
 	// This can be FALSE if house couldn't be built for some reasons
-	if (GetRMCProvider()->HaveMeshData())
+	if (GetRMCProvider()->HaveMeshData() && !bPatched)
 	{
-		GetRuntimeMeshComponent()->Initialize(GetRMCProvider());
+		BindRuntimeMesh();
 	}
 }
 
 void AHouseEditor::InstantiateElements()
 {
-	TArray<FName> MeshNames;
-	TArray<UStaticMeshComponent*> SMComps;
-
-	if (AllSegments.Num() == 0)
+	TArray<FHouseMeshPlacement> Placements;
+	if (!BuildVirtualHouse(Placements))
 	{
-		UE_LOG(LogTemp, Warning, TEXT("Can't instantiate meshes - there are no segments!"));
+		UE_LOG(LogTemp, Warning, TEXT("Can't instantiate meshes - house couldn't be built!"));
 		return;
 	}
 	
@@ -717,76 +1136,165 @@ void AHouseEditor::InstantiateElements()
 		InstancedElements.Pop()->DestroyComponent();
 	}
 
-	// Func to add instance to existing instance or create new one
-	auto AddInstancedElement = [&](UStaticMeshComponent*& Comp)
+	UHouseEditorFunctionLibrary::InstantiatePlacements(this, Placements, InstancedElements);
+
+	ClearHouse(false);
+	UpdateInstancedElementsBytes();
+}
+
+// Everything that goes into raw sections of a part. Render data is recreated when a mesh is rebuilt or reimported.
+// Transforms are taken relative to Origin and rounded, so identical strips of different walls and floors match despite float noise.
+static uint64 HashPartPlacements(const TArray<const FHouseMeshPlacement*>& Placements, const FTransform& Origin, int NumLODs)
+{
+	uint64 Hash = NumLODs;
+	const auto HashBytes = [&Hash](const void* Data, int64 Size)
+	{
+		Hash = CityHash64WithSeed(static_cast<const char*>(Data), Size, Hash);
+	};
+	for (const FHouseMeshPlacement* Placement : Placements)
 	{
-		const FName MeshName = Comp->GetStaticMesh()->GetFName();
-		const int Idx = MeshNames.Find(MeshName);
-		if (Idx >= 0)
+		const void* RenderData = Placement->Mesh->RenderData.Get();
+		const FTransform Local = Placement->Transform.GetRelativeTransform(Origin);
+		const FVector Location = Local.GetLocation();
+		FQuat Rotation = Local.GetRotation();
+		if (Rotation.W < 0.f)
 		{
-			InstancedElements[Idx]->AddInstanceWorldSpace(Comp->GetComponentTransform());
+			Rotation = Rotation * -1.f;
 		}
-		else
+		const int32 Rounded[7] = {
+			FMath::RoundToInt(Location.X * 100.f), FMath::RoundToInt(Location.Y * 100.f), FMath::RoundToInt(Location.Z * 100.f),
+			FMath::RoundToInt(Rotation.X * 10000.f), FMath::RoundToInt(Rotation.Y * 10000.f), FMath::RoundToInt(Rotation.Z * 10000.f), FMath::RoundToInt(Rotation.W * 10000.f)
+		};
+		HashBytes(&Placement->Mesh, sizeof(UStaticMesh*));
+		HashBytes(&RenderData, sizeof(void*));
+		HashBytes(Rounded, sizeof(Rounded));
+		HashBytes(Placement->Materials.GetData(), Placement->Materials.Num() * sizeof(UMaterialInterface*));
+	}
+	return Hash;
+}
+
+// Same key MergeSections merges by
+static string GetSectionKey(const EDGEMeshSectionData& Section)
+{
+	return to_string(Section.SectionData[4]) + ":" + Section.MaterialName;
+}
+
+static void AddSectionKeys(const vector<EDGEMeshSectionData>& Sections, TArray<string>& OutKeys)
+{
+	for (const EDGEMeshSectionData& Section : Sections)
+	{
+		OutKeys.AddUnique(GetSectionKey(Section));
+	}
+}
+
+// House space raw sections of the whole house, not merged yet. Only parts whose placements changed since the last call are read again.
+// Reads render data and the materials table, so game thread only.
+bool AHouseEditor::ExtractMeshData(vector<EDGEMeshSectionData>& OutRawSections, TArray<FBox>& OutCollisionBoxes, TArray<string>& OutDirtySectionKeys, bool& bOutAnyPartDirty)
+{
+	OutRawSections.clear();
+	vector<EDGEMeshSectionData> RawSections;
+
+	TArray<FHouseMeshPlacement> Placements;
+	if (!BuildVirtualHouse(Placements))
+	{
+		return false;
+	}
+
+	FVertexOffsetParams OffsetParams;
+	const int AuthoredLODs = GetAuthoredLODCount();
+
+	// Parts are floors of a wall, elements of a wall (Floor = -1) and the roof (-1, -1)
+	TMap<FIntPoint, TArray<const FHouseMeshPlacement*>> Parts;
+	for (const FHouseMeshPlacement& Placement : Placements)
+	{
+		// --- For now skip decorations
+		if (Placement.SourceClass != nullptr && Placement.SourceClass->IsChildOf<ABaseSegmentDecoration>())
 		{
-			UInstancedStaticMeshComponent* NewISMComp = NewObject<UInstancedStaticMeshComponent>(this, UInstancedStaticMeshComponent::StaticClass(), MeshName);
-			NewISMComp->RegisterComponent();
-			this->AddInstanceComponent(NewISMComp);
-			NewISMComp->SetStaticMesh(Comp->GetStaticMesh());
-			for (int MatIdx = 0; MatIdx < Comp->GetNumMaterials(); MatIdx++)
-			{
-				NewISMComp->SetMaterial(MatIdx, Comp->GetMaterial(MatIdx));
-			}
-			NewISMComp->AddInstanceWorldSpace(Comp->GetComponentTransform());
-			InstancedElements.Add(NewISMComp);
-			MeshNames.Add(MeshName);
+			continue;
 		}
-	};
+		Parts.FindOrAdd(FIntPoint(Placement.WallIndex, Placement.Floor)).Add(&Placement);
+	}
 
-	// Copy segments and decorations
-	for (auto& Segment : AllSegments)
+	// Only parts whose placements changed are read again, sections they touch (before and after) are dirty.
+	// Identical strips - repeated floor lines, opposite walls of one length - are read and merged once, copies are moved to their origin.
+	OutDirtySectionKeys.Empty();
+	bOutAnyPartDirty = false;
+	TMap<uint64, vector<EDGEMeshSectionData>> Strips;
+	for (const auto& Part : Parts)
 	{
-		TArray<AActor*> Attachements;
-		Segment->GetAttachedActors(Attachements);
-		for (auto& Attachement : Attachements)
+		const uint64 PartHash = HashPartPlacements(Part.Value, FTransform::Identity, AuthoredLODs);
+		FHousePartMesh& PartMesh = PartMeshes.FindOrAdd(Part.Key);
+		if (PartMesh.Hash == PartHash && PartMesh.RawSections.size() > 0)
+		{
+			continue;
+		}
+		AddSectionKeys(PartMesh.RawSections, OutDirtySectionKeys);
+		PartMesh.Hash = PartHash;
+		bOutAnyPartDirty = true;
+
+		const FTransform Origin = GetPartOrigin(Part.Key.X, Part.Key.Y);
+		const uint64 StripHash = HashPartPlacements(Part.Value, Origin, AuthoredLODs);
+		vector<EDGEMeshSectionData>* Strip = Strips.Find(StripHash);
+		if (Strip != nullptr)
+		{
+			INC_DWORD_STAT(STAT_EDGEHouses_StripsStamped);
+		}
+		else
 		{
-			Attachement->GetComponents<UStaticMeshComponent>(SMComps);
-			for (auto& SMComp : SMComps)
+			Strip = &Strips.Add(StripHash);
+			for (const FHouseMeshPlacement* Placement : Part.Value)
+			{
+				const FTransform Local = Placement->Transform.GetRelativeTransform(Origin);
+				OffsetParams.MeshRotation = Local.Rotator();
+				OffsetParams.PivotOffset = Local.GetLocation();
+				if (UEDGEMeshUtility::ReadMeshDataAsRaw(Placement->Mesh, Placement->Materials, OffsetParams, RawSections, AuthoredLODs))
+				{
+					Strip->insert(end(*Strip), begin(RawSections), end(RawSections));
+				}
+			}
+			if (Strip->size() > 0)
 			{
-				AddInstancedElement(SMComp);
+				UEDGEMeshUtility::MergeSections(*Strip);
 			}
+			INC_DWORD_STAT(STAT_EDGEHouses_StripsExtracted);
 		}
 
-		Segment->GetComponents<UStaticMeshComponent>(SMComps);
-		for (auto& SMComp : SMComps)
-		{
-			AddInstancedElement(SMComp);
-		}
+		PartMesh.RawSections = *Strip;
+		UEDGEMeshUtility::TransformRawSections(PartMesh.RawSections, Origin);
+		AddSectionKeys(PartMesh.RawSections, OutDirtySectionKeys);
 	}
-
-	// Copy custom elements
-	for (auto& Custom : AllCustoms)
+	for (auto It = PartMeshes.CreateIterator(); It; ++It)
 	{
-		Custom->GetComponents<UStaticMeshComponent>(SMComps);
-		for (auto& SMComp : SMComps)
+		if (!Parts.Contains(It.Key()))
 		{
-			AddInstancedElement(SMComp);
+			AddSectionKeys(It.Value().RawSections, OutDirtySectionKeys);
+			bOutAnyPartDirty = true;
+			It.RemoveCurrent();
 		}
 	}
 
-	// Copy roof
-	RoofActor->GetComponents<UStaticMeshComponent>(SMComps);		// MB make elements (such as cornices/pillars/roof) to create ISMs by default???
-	for (auto& SMComp : SMComps)
+	// Stable order, so unchanged parts keep their place in merged sections
+	PartMeshes.KeySort([](const FIntPoint& A, const FIntPoint& B) { return A.X != B.X ? A.X < B.X : A.Y < B.Y; });
+	for (const auto& PartMesh : PartMeshes)
 	{
-		AddInstancedElement(SMComp);
+		OutRawSections.insert(end(OutRawSections), begin(PartMesh.Value.RawSections), end(PartMesh.Value.RawSections));
 	}
 
-	ClearHouse(false);
-	
-	for (auto& ISM : InstancedElements)
+	// Far LOD is just a box around the house
+	if (GetDefault<UEdgeHouseConstructorSettings>()->bGenerateBoundsLOD)
 	{
-		ISM->MarkRenderStateDirty();
+		UEDGEMeshUtility::AppendBoundsLOD(OutRawSections, AuthoredLODs);
 	}
 
+	OutCollisionBoxes = CollectCollisionBoxes(Placements);
+	return true;
+}
+
+// Mesh LODs read from static meshes, bounds LOD comes on top of them
+int AHouseEditor::GetAuthoredLODCount() const
+{
+	const bool bGenerateBoundsLOD = GetDefault<UEdgeHouseConstructorSettings>()->bGenerateBoundsLOD;
+	return FMath::Max(GetLODScreenSizes().Num() - (bGenerateBoundsLOD ? 1 : 0), 1);
 }
 
 void AHouseEditor::GenerateMeshData()
@@ -796,8 +1304,10 @@ void AHouseEditor::GenerateMeshData()
 	
 	TArray<UMaterialInterface*> AllMaterials;
 	bool bDataFound = false;
+	bRuntimeMeshPatched = false;
+	MeshEditCount++;
 
-	const FString FileName = TemplateOverride.bOverMergedMesh ? GetLevel()->GetName() + "_" + GetName() : HouseTemplateName.ToString();
+	const FString FileName = GetMeshCacheKey();
 	
 	if (!bMeshIsDirty)
 	{
@@ -807,94 +1317,479 @@ void AHouseEditor::GenerateMeshData()
 	if (!bDataFound)
 	{
 		// If no file found - generate new one
-		vector<EDGEMeshSectionData> RawSections;
-		TArray<UStaticMeshComponent*> MeshComponents;
+		const double GenerationStartTime = FPlatformTime::Seconds();
+		TArray<FBox> CollisionBoxes;
+		TArray<string> DirtySectionKeys;
+		bool bAnyPartDirty = false;
+		if (!ExtractMeshData(AllRawSections, CollisionBoxes, DirtySectionKeys, bAnyPartDirty))
+		{
+			UE_LOG(LogTemp, Error, TEXT("House couldn't be rebuilt. Aborting mesh generation."));
+			return;
+		}
 
-		// Build house segments, if they are not present
-		if (AllSegments.Num() == 0)
+		const bool bGenerateBoundsLOD = GetDefault<UEdgeHouseConstructorSettings>()->bGenerateBoundsLOD;
+		const int AuthoredLODs = GetAuthoredLODCount();
+
+		UEDGEMeshUtility::MergeSections(AllRawSections);
+		UEDGEMeshUtility::WriteMeshDataToFile(FileName, AllRawSections, CollisionBoxes);
+		UEDGEMeshUtility::ConvertSectionDataToUnreal(AllRawSections, AllSections, AllMaterials);
+
+		// Merged sections map 1:1 to RMC sections. Bounds LOD depends on every part.
+		TArray<int32> DirtySections;
+		for (int SectionIdx = 0; SectionIdx < AllRawSections.size(); SectionIdx++)
 		{
-			if (!BuildHouse())
+			const bool bIsBoundsLOD = bGenerateBoundsLOD && AllRawSections[SectionIdx].SectionData[4] == AuthoredLODs;
+			if ((bIsBoundsLOD && bAnyPartDirty) || DirtySectionKeys.Contains(GetSectionKey(AllRawSections[SectionIdx])))
 			{
-				UE_LOG(LogTemp, Error, TEXT("House couldn't be rebuilt. Aborting mesh generation."));
-				return;
+				DirtySections.Add(SectionIdx);
 			}
 		}
 
-		// Start with roof meshes
-		if (RoofActor != nullptr)
+		const FName Name = *FString::Printf(TEXT("%s"), *FileName);
+
+		// Mesh showing only this house is patched in place, if only section contents changed: its own mesh, or a shared one no other house binds
+		UEDGERuntimeMeshProvider* PatchedProvider = nullptr;
+		if (RMCProvider != nullptr && RMCProvider->GetOuter() == this && RMCProvider->GetTemplateName() == Name)
 		{
-			RoofActor->GetComponents<UStaticMeshComponent>(MeshComponents);
+			URuntimeMesh* BoundMesh = GetRuntimeMeshComponent()->GetRuntimeMesh();
+			if (BoundMesh != nullptr && BoundMesh->GetOuter() == GetRuntimeMeshComponent() && BoundMesh->GetProviderPtr() == RMCProvider)
+			{
+				PatchedProvider = RMCProvider;
+			}
+			else
+			{
+				PatchedProvider = EDGERuntimeProviderManager::GetExclusiveSharedProvider(this, Name, GetRuntimeMeshComponent());
+			}
+		}
+		bRuntimeMeshPatched = PatchedProvider != nullptr && PatchedProvider->UpdateSectionsData(AllSections, AllMaterials, DirtySections);
+
+		if (bRuntimeMeshPatched)
+		{
+			PatchedProvider->SetCollisionBoxes(CollisionBoxes);
+			if (PatchedProvider != RMCProvider)
+			{
+				// Own provider is what the cache hands out, so it takes the patched data too
+				RMCProvider->SetSnapshot(PatchedProvider->GetSnapshot());
+				EDGERuntimeProviderManager::OnSharedMeshPatched(this, Name, PatchedProvider);
+			}
+			EDGERuntimeProviderManager::AddProvider(this, Name, RMCProvider);
+			EDGERuntimeProviderManager::RecordGeneration(Name, FPlatformTime::Seconds() - GenerationStartTime);
+		}
+		else
+		{
+			SetGeneratedProvider(Name, AllSections, AllMaterials, CollisionBoxes, FPlatformTime::Seconds() - GenerationStartTime);
 		}
+	}
+
+	FinishMeshData();
+}
+
+// New provider of this house, shared with houses of the same cache key
+void AHouseEditor::SetGeneratedProvider(FName Name, const TArray<FRMCSectionData>& Sections, const TArray<UMaterialInterface*>& Materials, const TArray<FBox>& CollisionBoxes, double GenerationSeconds)
+{
+	bRuntimeMeshPatched = false;
+	RMCProvider = NewObject<UEDGERuntimeMeshProvider>(this);
+	RMCProvider->SetTemplateName(Name);
+	RMCProvider->SetSectionsData(Sections);
+	RMCProvider->SetMaterials(Materials);
+	RMCProvider->SetCollisionBoxes(CollisionBoxes);
+
+	EDGERuntimeProviderManager::AddProvider(this, Name, RMCProvider);
+	EDGERuntimeProviderManager::RecordGeneration(Name, GenerationSeconds);
+}
+
+void AHouseEditor::FinishMeshData()
+{
+	GetRMCProvider()->SetLODSettings(GetLODScreenSizes(), GetLODCastShadows());
+
+	GetHouseNavCollider()->SetRelativeLocation(GetRMCProvider()->GetBoxCenter());
+	GetHouseNavCollider()->SetBoxExtent(GetRMCProvider()->GetBoxRadius());
 	
-		// Collect meshes from segment and decorations
-		for (auto& Segment : AllSegments)
+	bMeshIsDirty = false;
+}
+
+// Boxes in house space: one per wall slab (with its quoins and pilasters) and roof, ladders and cornices optionally get own ones
+TArray<FBox> AHouseEditor::CollectCollisionBoxes(const TArray<FHouseMeshPlacement>& Placements) const
+{
+	const UEdgeHouseConstructorSettings* Settings = GetDefault<UEdgeHouseConstructorSettings>();
+	TArray<FBox> WallBoxes;
+	WallBoxes.Init(FBox(ForceInit), Walls.Num());
+	TMap<int, FBox> ElementBoxes;
+	FBox RoofBox(ForceInit);
+
+	for (const FHouseMeshPlacement& Placement : Placements)
+	{
+		if (Placement.SourceClass == nullptr || Placement.SourceClass->IsChildOf<ABaseSegmentDecoration>())
 		{
-			TArray<UStaticMeshComponent*> ThisComponents;
-			Segment->GetComponents<UStaticMeshComponent>(ThisComponents);
-			MeshComponents.Append(ThisComponents);
+			continue;
+		}
+		const FBox Box = Placement.Mesh->GetBounds().GetBox().TransformBy(Placement.Transform);
 
-			// --- For now skip decorations
-			// TArray<AActor*> Attachements;
-			// Segment->GetAttachedActors(Attachements);
-			// for (auto& Actor : Attachements)
-			// {
-			// 	ABaseSegmentDecoration* Decor = Cast<ABaseSegmentDecoration>(Actor);
-			// 	if (Decor != nullptr)
-			// 	{
-			// 		Decor->GetComponents<UStaticMeshComponent>(ThisComponents);
-			// 	}
-			// 	MeshComponents.Append(ThisComponents);
-			// }
+		const bool bIsLadder = Placement.SourceClass->IsChildOf<ABaseFireLadder>();
+		const bool bIsCornice = Placement.SourceClass->IsChildOf<ABaseCornice>();
+		if ((bIsLadder && Settings->bLadderCollision) || (bIsCornice && Settings->bCorniceCollision))
+		{
+			ElementBoxes.FindOrAdd(Placement.ElementIndex, FBox(ForceInit)) += Box;
 		}
+		else if (Placement.SourceClass->IsChildOf<ABaseRoof>())
+		{
+			RoofBox += Box;
+		}
+		else if (!bIsLadder && !bIsCornice && WallBoxes.IsValidIndex(Placement.WallIndex))
+		{
+			WallBoxes[Placement.WallIndex] += Box;
+		}
+	}
+
+	TArray<FBox> Boxes;
+	ElementBoxes.GenerateValueArray(Boxes);
+	Boxes.Append(WallBoxes);
+	Boxes.Add(RoofBox);
+
+	Boxes.RemoveAll([](const FBox& Box) { return !Box.IsValid; });
+	return Boxes;
+}
 
-		// Collect meshes from house elements
-		for (auto& Element : AllCustoms)
+void AHouseEditor::UpdateInstancedElementsBytes()
+{
+	int64 Bytes = 0;
+	for (UInstancedStaticMeshComponent* ISM : InstancedElements)
+	{
+		if (ISM != nullptr)
 		{
-			TArray<UStaticMeshComponent*> ThisComponents;
-			Element->GetComponents<UStaticMeshComponent>(ThisComponents);
-			MeshComponents.Append(ThisComponents);
+			Bytes += ISM->GetResourceSizeBytes(EResourceSizeMode::EstimatedTotal);
 		}
+	}
 
-		FVertexOffsetParams OffsetParams;
-	
-		for (auto& MeshComponent : MeshComponents)
+	DEC_MEMORY_STAT_BY(STAT_EDGEHouses_InstancedElementsMemory, InstancedElementsBytes);
+	INC_MEMORY_STAT_BY(STAT_EDGEHouses_InstancedElementsMemory, Bytes);
+	InstancedElementsBytes = Bytes;
+}
+
+void AHouseEditor::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	RemoveTemplateInstance();
+	Super::EndPlay(EndPlayReason);
+}
+
+void AHouseEditor::BeginDestroy()
+{
+	DEC_MEMORY_STAT_BY(STAT_EDGEHouses_InstancedElementsMemory, InstancedElementsBytes);
+	InstancedElementsBytes = 0;
+	Super::BeginDestroy();
+}
+
+// Counters are kept by their owners, here they are only summed up. Mesh data and runtime meshes shared by houses of one template count once for it.
+void AHouseEditor::DumpMemory(const TArray<FString>& Args)
+{
+	const int32 MaxEntries = Args.Num() > 0 ? FMath::Max(1, FCString::Atoi(*Args[0])) : 10;
+
+	struct FMemoryEntry
+	{
+		FString Name;
+		int32 Houses = 0;
+		int64 MeshDataBytes = 0;
+		int64 RenderBytes = 0;
+		int64 CollisionBytes = 0;
+		int64 InstancedBytes = 0;
+
+		int64 GetTotal() const
 		{
-			USceneComponent* HousePoint = MeshComponent->GetAttachParent();
-			while (HousePoint->GetOwner() != this)
-			{
-				HousePoint = HousePoint->GetAttachParent();
-			}
-			OffsetParams.MeshRotation = MeshComponent->GetComponentRotation() - GetActorRotation();
-			OffsetParams.PivotOffset = GetActorRotation().UnrotateVector(MeshComponent->GetComponentLocation() - HousePoint->GetComponentLocation()) + HousePoint->GetRelativeLocation();
-			if (UEDGEMeshUtility::ReadMeshDataAsRaw(MeshComponent, OffsetParams, RawSections))
-			{
-				// Add sections to All array
-				for (auto& RawSection : RawSections)
-				{
-					AllRawSections.push_back(RawSection);
-				}
-			}
+			return MeshDataBytes + RenderBytes + CollisionBytes + InstancedBytes;
 		}
+	};
 
-		UEDGEMeshUtility::MergeSections(AllRawSections);
-		UEDGEMeshUtility::WriteMeshDataToFile(FileName, AllRawSections);
-		UEDGEMeshUtility::ConvertSectionDataToUnreal(AllRawSections, AllSections, AllMaterials);
+	TArray<FMemoryEntry> Houses;
+	TMap<FString, FMemoryEntry> Templates;
+	TSet<const FEDGEMeshSnapshot*> CountedSnapshots;
+	TSet<const URuntimeMesh*> CountedMeshes;
 
-		const FName Name = *FString::Printf(TEXT("%s"), *FileName);
-		
-		RMCProvider = NewObject<UEDGERuntimeMeshProvider>(this);
-		RMCProvider->SetTemplateName(Name);
-		RMCProvider->SetSectionsData(AllSections);
-		RMCProvider->SetMaterials(AllMaterials);
+	for (TObjectIterator<AHouseEditor> It; It; ++It)
+	{
+		AHouseEditor* House = *It;
+		if (House->HasAnyFlags(RF_ClassDefaultObject | RF_ArchetypeObject) || House->IsPendingKill())
+		{
+			continue;
+		}
+
+		FMemoryEntry& Entry = Houses.AddDefaulted_GetRef();
+		Entry.Name = House->GetName();
+		Entry.Houses = 1;
+		Entry.InstancedBytes = House->InstancedElementsBytes;
+		if (House->RMCProvider != nullptr)
+		{
+			Entry.MeshDataBytes = House->RMCProvider->GetSnapshotBytes();
+		}
+		if (URuntimeMesh* Mesh = House->RuntimeMeshComponent != nullptr ? House->RuntimeMeshComponent->GetRuntimeMesh() : nullptr)
+		{
+			Entry.RenderBytes = Mesh->GetRenderDataBytes();
+			Entry.CollisionBytes = Mesh->GetBodySetupBytes();
+		}
+
+		const FString Key = House->GetMeshCacheKey();
+		FMemoryEntry& Template = Templates.FindOrAdd(Key);
+		Template.Name = Key;
+		Template.Houses++;
+		Template.InstancedBytes += Entry.InstancedBytes;
+
+		bool bAlreadyCounted = false;
+		CountedMeshes.Add(House->RuntimeMeshComponent != nullptr ? House->RuntimeMeshComponent->GetRuntimeMesh() : nullptr, &bAlreadyCounted);
+		if (!bAlreadyCounted)
+		{
+			Template.RenderBytes += Entry.RenderBytes;
+			Template.CollisionBytes += Entry.CollisionBytes;
+		}
 
-		EDGERuntimeProviderManager::AddProvider(this, Name, RMCProvider);
+		CountedSnapshots.Add(House->RMCProvider != nullptr ? House->RMCProvider->GetSnapshot().Get() : nullptr, &bAlreadyCounted);
+		if (!bAlreadyCounted)
+		{
+			Template.MeshDataBytes += Entry.MeshDataBytes;
+		}
 	}
 
-	GetHouseNavCollider()->SetRelativeLocation(GetRMCProvider()->GetBoxCenter());
-	GetHouseNavCollider()->SetBoxExtent(GetRMCProvider()->GetBoxRadius());
-	
+	const auto ByTotal = [](const FMemoryEntry& A, const FMemoryEntry& B)
+	{
+		return A.GetTotal() > B.GetTotal();
+	};
+	const auto LogEntry = [](const FMemoryEntry& Entry, int64 CachedBytes)
+	{
+		UE_LOG(LogTemp, Display, TEXT("~~ %-40s %6d %10.1f %10.1f %10.1f %10.1f %10.1f %10.1f"),
+			*Entry.Name, Entry.Houses, Entry.GetTotal() / 1024.0, Entry.MeshDataBytes / 1024.0, Entry.RenderBytes / 1024.0,
+			Entry.CollisionBytes / 1024.0, Entry.InstancedBytes / 1024.0, CachedBytes / 1024.0);
+	};
+
+	FMemoryEntry Total;
+	Total.Houses = Houses.Num();
+	int64 TotalCachedBytes = 0;
+	for (const auto& TemplatePair : Templates)
+	{
+		Total.MeshDataBytes += TemplatePair.Value.MeshDataBytes;
+		Total.RenderBytes += TemplatePair.Value.RenderBytes;
+		Total.CollisionBytes += TemplatePair.Value.CollisionBytes;
+		Total.InstancedBytes += TemplatePair.Value.InstancedBytes;
+		TotalCachedBytes += EDGERuntimeProviderManager::GetCachedBytes(FName(*TemplatePair.Key));
+	}
+	Total.Name = TEXT("Total");
+
+	UE_LOG(LogTemp, Display, TEXT("~~ %-40s %6s %10s %10s %10s %10s %10s %10s"),
+		TEXT("Name"), TEXT("Houses"), TEXT("Total KB"), TEXT("Data KB"), TEXT("Render KB"), TEXT("Coll. KB"), TEXT("ISM KB"), TEXT("Cache KB"));
+	LogEntry(Total, TotalCachedBytes);
+
+	Houses.Sort(ByTotal);
+	UE_LOG(LogTemp, Display, TEXT("~~ Top houses:"));
+	for (int32 Idx = 0; Idx < FMath::Min(MaxEntries, Houses.Num()); Idx++)
+	{
+		LogEntry(Houses[Idx], 0);
+	}
+
+	Templates.ValueSort(ByTotal);
+	UE_LOG(LogTemp, Display, TEXT("~~ Top templates:"));
+	int32 NumLogged = 0;
+	for (const auto& TemplatePair : Templates)
+	{
+		if (NumLogged++ >= MaxEntries)
+		{
+			break;
+		}
+		LogEntry(TemplatePair.Value, EDGERuntimeProviderManager::GetCachedBytes(FName(*TemplatePair.Key)));
+	}
+}
+
+// Seed <= 0 asks for a random one. It only drives decorations, which are not part of the mesh, so it stays out of the cache key.
+void AHouseEditor::FinalizeRandomSeed()
+{
+	if (TemplateLocal.RandomSeed <= 0)
+	{
+		TemplateLocal.RandomSeed = UHouseEditorFunctionLibrary::MakeRandomSeed();
+	}
+}
+
+// Houses with overridden mesh share data with identical overrides, others share it by template
+FString AHouseEditor::GetMeshCacheKey() const
+{
+	return TemplateOverride.bOverMergedMesh ? HouseTemplateName.ToString() + "_" + FString::Printf(TEXT("%016llx"), GetResolvedTemplateHash()) : HouseTemplateName.ToString();
+}
+
+// Identity of the resolved template - everything that ends up in the mesh. Built from names and paths, so it is stable between sessions.
+uint64 AHouseEditor::GetResolvedTemplateHash() const
+{
+	FString Identity = FString::Printf(TEXT("%i|%i|%i|%i|%i|"), TemplateLocal.HouseHeight, TemplateLocal.HouseLength, TemplateLocal.HouseWidth,
+		TemplateLocal.bPilasterIgnoreGroundFloor ? 1 : 0, TemplateLocal.bGlobalDecorationsIgnoreGroundFloor ? 1 : 0);
+
+	for (const UObject* Object : { static_cast<const UObject*>(TemplateLocal.PilasterClass.Get()), static_cast<const UObject*>(TemplateLocal.QuoinClass.Get()),
+		static_cast<const UObject*>(TemplateLocal.RoofClass.Get()), static_cast<const UObject*>(TemplateLocal.FireLadderClass.Get()),
+		static_cast<const UObject*>(TemplateLocal.BottomCorniceClass.Get()), static_cast<const UObject*>(TemplateLocal.TopCorniceClass.Get()),
+		static_cast<const UObject*>(TemplateLocal.WallMatOverride) })
+	{
+		Identity += GetPathNameSafe(Object) + TEXT("|");
+	}
+	for (const FName& Pattern : TemplateLocal.WallPatterns)
+	{
+		Identity += Pattern.ToString() + TEXT("|");
+	}
+	for (const TArray<int>* Values : { &TemplateLocal.PilasterOffsets, &TemplateLocal.PilasterRates, &TemplateLocal.FireLadderOffsets, &TemplateLocal.FireLadderRates })
+	{
+		for (const int Value : *Values)
+		{
+			Identity += FString::Printf(TEXT("%i,"), Value);
+		}
+		Identity += TEXT("|");
+	}
+	for (const FSegmentDecorationsData& Weights : TemplateLocal.GlobalDecorationWeights)
+	{
+		Identity += Weights.SocketName.ToString() + TEXT(":");
+		// Map order depends on how the weights were edited, not on what they are
+		TMap<FName, float> SortedWeights = Weights.SocketDecorationWeights;
+		SortedWeights.KeySort(FNameLexicalLess());
+		for (const auto& Weight : SortedWeights)
+		{
+			Identity += FString::Printf(TEXT("%s=%g,"), *Weight.Key.ToString(), Weight.Value);
+		}
+		Identity += TEXT("|");
+	}
+	for (const float ScreenSize : TemplateLocal.LODScreenSizes)
+	{
+		Identity += FString::Printf(TEXT("%g,"), ScreenSize);
+	}
+	for (const bool bCastShadow : TemplateLocal.LODCastShadows)
+	{
+		Identity += bCastShadow ? TEXT("1") : TEXT("0");
+	}
+
+	return CityHash64(reinterpret_cast<const char*>(*Identity), Identity.Len() * sizeof(TCHAR));
+}
+
+// Houses of a level grouped by resolved template: one of each group generates mesh data, the rest read it from the cache. Runs before level save.
+void AHouseEditor::DeduplicateHouses(UWorld* World)
+{
+	if (World == nullptr)
+	{
+		return;
+	}
+
+	TMap<FString, TArray<AHouseEditor*>> Groups;
+	int32 NumHouses = 0;
+	for (TActorIterator<AHouseEditor> It(World); It; ++It)
+	{
+		AHouseEditor* House = *It;
+		if (House->IsPendingKill() || House->GetRMCProvider() == nullptr)
+		{
+			continue;
+		}
+		Groups.FindOrAdd(House->GetMeshCacheKey()).Add(House);
+		NumHouses++;
+	}
+
+	int32 NumBuilds = 0;
+	int32 NumAvoided = 0;
+	for (const auto& Group : Groups)
+	{
+		TArray<AHouseEditor*> Stale = Group.Value.FilterByPredicate([](const AHouseEditor* House)
+		{
+			return House->NeedsMeshData();
+		});
+		if (Stale.Num() == 0)
+		{
+			continue;
+		}
+
+		// First one writes file and cache, others find it there
+		Stale[0]->GenerateMeshData();
+		NumBuilds++;
+		for (int Idx = 1; Idx < Stale.Num(); Idx++)
+		{
+			Stale[Idx]->TakeCachedMeshData();
+			NumAvoided++;
+		}
+
+		for (AHouseEditor* House : Stale)
+		{
+			House->ShowGeneratedMesh(false);
+		}
+	}
+
+	UE_LOG(LogTemp, Display, TEXT("~~ Houses deduplicated in %s: %i houses, %i unique, %i built, %i builds avoided."),
+		*World->GetName(), NumHouses, Groups.Num(), NumBuilds, NumAvoided);
+}
+
+bool AHouseEditor::NeedsMeshData() const
+{
+	return bMeshIsDirty || GetRMCProvider() == nullptr || !GetRMCProvider()->HaveMeshData();
+}
+
+// Changes whenever the template is read or edited and whenever the house generates or takes mesh data,
+// so mesh data extracted earlier can tell it is out of date
+uint32 AHouseEditor::GetMeshEditCount() const
+{
+	return MeshEditCount;
+}
+
+// For houses sharing the cache key of one that has just generated its mesh data
+void AHouseEditor::TakeCachedMeshData()
+{
 	bMeshIsDirty = false;
+	GenerateMeshData();
+}
 
+// Houses being edited keep showing their elements
+void AHouseEditor::ShowGeneratedMesh(bool bDeferBind)
+{
+	if (AllSegments.Num() == 0 && GetRMCProvider()->HaveMeshData())
+	{
+		ClearHouse(false);
+		if (bDeferBind)
+		{
+			RequestBindRuntimeMesh();
+		}
+		else
+		{
+			BindRuntimeMesh();
+		}
+	}
+}
+
+// Template values have priority, plugin settings are used for houses without own LODs setup
+TArray<float> AHouseEditor::GetLODScreenSizes() const
+{
+	if (TemplateLocal.LODScreenSizes.Num() > 0)
+	{
+		return TemplateLocal.LODScreenSizes;
+	}
+	return GetDefault<UEdgeHouseConstructorSettings>()->LODScreenSizes;
+}
+
+// Same as screen sizes: a template can turn shadows off for its far LODs, other houses use plugin settings
+TArray<bool> AHouseEditor::GetLODCastShadows() const
+{
+	if (TemplateLocal.LODCastShadows.Num() > 0)
+	{
+		return TemplateLocal.LODCastShadows;
+	}
+	return GetDefault<UEdgeHouseConstructorSettings>()->LODCastShadows;
+}
+
+// Space a part of the house is built in: wall anchor for elements of a wall, raised to the floor for its segments. Roof (no wall) is in house space.
+FTransform AHouseEditor::GetPartOrigin(int WallIndex, int Floor) const
+{
+	FTransform Anchor;
+	switch (WallIndex)		// works for now - cause using only "box"-houses
+	{
+	case 0:
+		Anchor = FTransform(FRotator(0, 0, 0), FVector(0));
+		break;
+	case 1:
+		Anchor = FTransform(FRotator(0, -90, 0), FVector(SegmentWidthInUnits * TemplateLocal.HouseLength, 0, 0));
+		break;
+	case 2:
+		Anchor = FTransform(FRotator(0, -180, 0), FVector(SegmentWidthInUnits * TemplateLocal.HouseLength, SegmentWidthInUnits * -TemplateLocal.HouseWidth, 0));
+		break;
+	case 3:
+		Anchor = FTransform(FRotator(0, -270, 0), FVector(0, SegmentWidthInUnits * -TemplateLocal.HouseWidth, 0));
+		break;
+	default:
+		return FTransform::Identity;
+	}
+	return Floor == INDEX_NONE ? Anchor : FTransform(FVector(0, 0, GetRealHeight(Floor))) * Anchor;
 }
 
 // Floor = 0 means ground floor, where cornice offset never used
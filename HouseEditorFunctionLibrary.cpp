@@ -2,6 +2,7 @@
 
 
 #include "HouseEditor/HouseEditorFunctionLibrary.h"
+#include "HouseEditor/HouseEditorStats.h"
 
 #include "ImageUtils.h"
 #include "ObjectTools.h"
@@ -16,72 +17,301 @@
 #include "SegmentEditor/BaseSegment.h"
 #include "SegmentEditor/BaseSegmentDecoration.h"
 #include "ThumbnailRendering/ThumbnailManager.h"
+#include "Engine/BlueprintGeneratedClass.h"
+#include "Engine/SCS_Node.h"
+#include "Engine/SimpleConstructionScript.h"
+#include "Components/HierarchicalInstancedStaticMeshComponent.h"
+#include "HAL/IConsoleManager.h"
+#include "GameFramework/PlayerController.h"
+#include "Misc/DelayedAutoRegister.h"
+#include "Engine/World.h"
+#if WITH_EDITOR
+#include "Editor.h"
+#endif
 
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Pooled Element Actors"), STAT_EDGEHouses_PooledElements, STATGROUP_EDGEHouses);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Element Actors Reused"), STAT_EDGEHouses_ElementsReused, STATGROUP_EDGEHouses);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Element Actors Spawned"), STAT_EDGEHouses_ElementsSpawned, STATGROUP_EDGEHouses);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Element Components Reused"), STAT_EDGEHouses_ComponentsReused, STATGROUP_EDGEHouses);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Element Components Created"), STAT_EDGEHouses_ComponentsCreated, STATGROUP_EDGEHouses);
 
-UDataTable* UHouseEditorFunctionLibrary::GetPatternDataTable()
+static TAutoConsoleVariable<int32> CVarElementPoolSize(
+	TEXT("EDGE.Houses.ElementPoolSize"),
+	512,
+	TEXT("How many released segment, decoration and element actors of one class are kept hidden for reuse by later rebuilds."));
+
+TMap<TWeakObjectPtr<UClass>, FHouseClassMetadata> UHouseEditorFunctionLibrary::ClassMetadataCache;
+TMap<FDecorationAliasKey, FDecorationAliasTable> UHouseEditorFunctionLibrary::DecorationAliasTables;
+TArray<TArray<TPair<FName, float>>> UHouseEditorFunctionLibrary::DecorationWeightSets;
+TMultiMap<uint32, int32> UHouseEditorFunctionLibrary::DecorationWeightSetIds;
+FHouseDataRegistry UHouseEditorFunctionLibrary::DataRegistry;
+FDelegateHandle UHouseEditorFunctionLibrary::SettingsChangedHandle;
+TMap<TWeakObjectPtr<UClass>, TArray<TWeakObjectPtr<AActor>>> UHouseEditorFunctionLibrary::ElementPool;
+
+
+// Resolves a table from plugin settings and checks its row struct
+static UDataTable* ResolveDataTable(EDataTableType Type, const UScriptStruct* RowStruct, const TCHAR* TableName)
 {
-	UDataTable* PatternDataTable = GetDataTableByType(PatternData);
-	if (PatternDataTable == nullptr)
+	UDataTable* DataTable = UHouseEditorFunctionLibrary::GetDataTableByType(Type);
+	if (DataTable == nullptr)
 	{
-		UE_LOG(LogTemp, Error, TEXT("Pattern Data Table was not found. Please, check Edge House Constructor plugin settings."));
+		UE_LOG(LogTemp, Error, TEXT("%s Data Table was not found. Please, check Edge House Constructor plugin settings."), TableName);
 		return NULL;
 	}
-	if (PatternDataTable->GetRowStruct() != FPatternData::StaticStruct())
+	if (DataTable->GetRowStruct() != RowStruct)
 	{
-		UE_LOG(LogTemp, Error, TEXT("Pattern Data Table has wrong row struct, must be <PatternData>. Please, check Edge House Constructor plugin settings."));
+		UE_LOG(LogTemp, Error, TEXT("%s Data Table has wrong row struct, must be <%s>. Please, check Edge House Constructor plugin settings."), TableName, *RowStruct->GetName());
 		return NULL;
 	}
-	return PatternDataTable;
+	return DataTable;
 }
 
-UDataTable* UHouseEditorFunctionLibrary::GetSegmentDataTable()
+// Flat form of a pattern for wall evaluation: segments of all lines in one array with resolved classes and sizes,
+// each pointing to the one that follows it on a wall, so repeat rules need no branching while placing.
+// Rows and segment classes are copied in, so a build holding the pattern doesn't depend on the registry staying as it is.
+static TSharedRef<const FCompiledPattern> CompilePattern(const FPatternData& Data, const TMap<FName, FRegisteredSegment>& Segments, uint32 Generation)
 {
-	UDataTable* SegmentDataTable = GetDataTableByType(SegmentData);
-	if (SegmentDataTable == nullptr)
-	{
-		UE_LOG(LogTemp, Error, TEXT("Segment Data Table was not found. Please, check Edge House Constructor plugin settings."));
-		return NULL;
-	}
-	if (SegmentDataTable->GetRowStruct() != FSegmentClassesData::StaticStruct())
+	TSharedRef<FCompiledPattern> Compiled = MakeShared<FCompiledPattern>();
+	FCompiledPattern& Out = Compiled.Get();
+	Out.Generation = Generation;
+	Out.bRepeatPattern = Data.bRepeatPattern;
+	Out.bValid = Data.Lines.Num() > 0;
+	Out.Lines.Reserve(Data.Lines.Num());
+	for (const FPatternLine& Line : Data.Lines)
 	{
-		UE_LOG(LogTemp, Error, TEXT("Segment Data Table has wrong row struct, must be <SegmentClassesData>. Please, check Edge House Constructor plugin settings."));
-		return NULL;
+		FCompiledPatternLine& CompiledLine = Out.Lines.AddDefaulted_GetRef();
+		CompiledLine.FirstSegment = Out.Segments.Num();
+		CompiledLine.NumSegments = Line.Segments.Num();
+		CompiledLine.Width = 0;
+		CompiledLine.bRepeatLine = Line.bRepeatLine;
+		Out.bValid &= Line.Segments.Num() > 0;
+
+		for (int SegmentIndex = 0; SegmentIndex < Line.Segments.Num(); SegmentIndex++)
+		{
+			FCompiledPatternSegment& Segment = Out.Segments.AddDefaulted_GetRef();
+			Segment.Source = Line.Segments[SegmentIndex];
+			Segment.Size = 1;
+			const FRegisteredSegment* Registered = Segments.Find(Line.Segments[SegmentIndex].SegmentName);
+			if (Registered != nullptr && Registered->Class != NULL)
+			{
+				Segment.Class = Registered->Class;
+				Segment.Sockets = Registered->Sockets;
+				Segment.Size = FMath::Max(Registered->Size, 1);
+				for (const FName& Socket : Segment.Sockets)
+				{
+					Segment.SocketWeightsIds.Add(UHouseEditorFunctionLibrary::GetSegmentDecorationWeightsId(Segment.Source, Socket));
+				}
+			}
+			Segment.Offset = CompiledLine.Width;
+			CompiledLine.Width += Segment.Size;
+
+			// Last one of a line that doesn't repeat stays for the rest of the wall
+			const bool bLast = SegmentIndex == Line.Segments.Num() - 1;
+			Segment.Next = !bLast ? Out.Segments.Num() : (Line.bRepeatLine ? CompiledLine.FirstSegment : Out.Segments.Num() - 1);
+		}
 	}
-	return SegmentDataTable;
+	return Compiled;
 }
 
-UDataTable* UHouseEditorFunctionLibrary::GetSegmentDecorationDataTable()
+// Line used by a floor, pattern without repeat keeps its last line for upper floors
+int32 FCompiledPattern::GetLineIndex(int Floor) const
 {
-	UDataTable* SegmentDecorationDataTable = GetDataTableByType(SegmentDecorationData);
-	if (SegmentDecorationDataTable == nullptr)
+	return bRepeatPattern ? Floor % Lines.Num() : FMath::Min(Floor, Lines.Num() - 1);
+}
+
+// Rows of all four tables resolved into flat lookups. Built on first use, dropped when a table or the plugin settings change.
+const FHouseDataRegistry& UHouseEditorFunctionLibrary::GetDataRegistry()
+{
+	check(IsInGameThread());
+
+	// Built once, a missing table included - its error is logged once and lookups just find nothing until settings are fixed
+	if (DataRegistry.bBuilt)
 	{
-		UE_LOG(LogTemp, Error, TEXT("Segment Decoration Data Table was not found. Please, check Edge House Constructor plugin settings."));
-		return NULL;
+		return DataRegistry;
 	}
-	if (SegmentDecorationDataTable->GetRowStruct() != FSegmentDecorationClassesData::StaticStruct())
+
+	if (!SettingsChangedHandle.IsValid())
 	{
-		UE_LOG(LogTemp, Error, TEXT("Segment Decoration Data Table has wrong row struct, must be <SegmentDecorationClassesData>. Please, check Edge House Constructor plugin settings."));
-		return NULL;
+		SettingsChangedHandle = FCoreUObjectDelegates::OnObjectPropertyChanged.AddLambda([](UObject* Object, FPropertyChangedEvent&)
+		{
+			if (Object == GetDefault<UEdgeHouseConstructorSettings>())
+			{
+				InvalidateDataRegistry();
+			}
+		});
+
+		// Rows are referenced by address, a table going away (deleted or unloaded asset) must not leave them behind
+		FCoreUObjectDelegates::GetPostGarbageCollect().AddLambda([]()
+		{
+			for (const TWeakObjectPtr<UDataTable>& Table : { DataRegistry.PatternTable, DataRegistry.SegmentTable, DataRegistry.DecorationTable, DataRegistry.TemplateTable })
+			{
+				if (Table.IsStale())
+				{
+					InvalidateDataRegistry();
+					return;
+				}
+			}
+		});
 	}
+	DataRegistry.bBuilt = true;
+
+	UDataTable* PatternTable = ResolveDataTable(PatternData, FPatternData::StaticStruct(), TEXT("Pattern"));
+	UDataTable* SegmentTable = ResolveDataTable(SegmentData, FSegmentClassesData::StaticStruct(), TEXT("Segment"));
+	UDataTable* DecorationTable = ResolveDataTable(SegmentDecorationData, FSegmentDecorationClassesData::StaticStruct(), TEXT("Segment Decoration"));
+	UDataTable* TemplateTable = ResolveDataTable(HouseTemplate, FHouseParamsTemplate::StaticStruct(), TEXT("House Params Template"));
+	DataRegistry.PatternTable = PatternTable;
+	DataRegistry.SegmentTable = SegmentTable;
+	DataRegistry.DecorationTable = DecorationTable;
+	DataRegistry.TemplateTable = TemplateTable;
+	DataRegistry.bComplete = PatternTable != nullptr && SegmentTable != nullptr && DecorationTable != nullptr && TemplateTable != nullptr;
 
-	return SegmentDecorationDataTable;
+	for (UDataTable* Table : { PatternTable, SegmentTable, DecorationTable, TemplateTable })
+	{
+		if (Table != nullptr)
+		{
+			DataRegistry.ChangedHandles.Add(Table, Table->OnDataTableChanged().AddStatic(&UHouseEditorFunctionLibrary::InvalidateDataRegistry));
+		}
+	}
+
+	if (PatternTable != nullptr)
+	{
+		for (const auto& Row : PatternTable->GetRowMap())
+		{
+			DataRegistry.Patterns.Add(Row.Key, reinterpret_cast<const FPatternData*>(Row.Value));
+		}
+	}
+	if (TemplateTable != nullptr)
+	{
+		for (const auto& Row : TemplateTable->GetRowMap())
+		{
+			DataRegistry.Templates.Add(Row.Key, reinterpret_cast<const FHouseParamsTemplate*>(Row.Value));
+		}
+	}
+	if (SegmentTable != nullptr)
+	{
+		for (const auto& Row : SegmentTable->GetRowMap())
+		{
+			const FSegmentClassesData* RowData = reinterpret_cast<const FSegmentClassesData*>(Row.Value);
+			FRegisteredSegment& Segment = DataRegistry.Segments.Add(Row.Key);
+			Segment.Class = RowData->SegmentClass;
+			Segment.Image = RowData->SegmentImage;
+			if (Segment.Class != NULL)
+			{
+				const ABaseSegment* Defaults = Segment.Class.GetDefaultObject();
+				Segment.Size = Defaults->GetSegmentSize();
+				Segment.Sockets = Defaults->GetDecorationSocketsNames();
+			}
+		}
+	}
+	if (DecorationTable != nullptr)
+	{
+		for (const auto& Row : DecorationTable->GetRowMap())
+		{
+			DataRegistry.Decorations.Add(Row.Key, reinterpret_cast<const FSegmentDecorationClassesData*>(Row.Value)->SegmentDecorationClass);
+		}
+	}
+
+	// Compiled after segments are in
+	DataRegistry.CompiledPatterns.Reserve(DataRegistry.Patterns.Num());
+	for (const auto& Pattern : DataRegistry.Patterns)
+	{
+		DataRegistry.CompiledPatterns.Add(Pattern.Key, CompilePattern(*Pattern.Value, DataRegistry.Segments, DataRegistry.Generation));
+	}
+
+	return DataRegistry;
 }
 
-UDataTable* UHouseEditorFunctionLibrary::GetHouseParamsTemplateDataTable()
+void UHouseEditorFunctionLibrary::InvalidateDataRegistry()
 {
-	UDataTable* HouseParamsTemplateDataTable = GetDataTableByType(HouseTemplate);
-	if (HouseParamsTemplateDataTable == nullptr)
+	for (const auto& Handle : DataRegistry.ChangedHandles)
 	{
-		UE_LOG(LogTemp, Error, TEXT("House Params Template Data Table was not found. Please, check Edge House Constructor plugin settings."));
-		return NULL;
+		if (UDataTable* Table = Handle.Key.Get())
+		{
+			Table->OnDataTableChanged().Remove(Handle.Value);
+		}
 	}
-	if (HouseParamsTemplateDataTable->GetRowStruct() != FHouseParamsTemplate::StaticStruct())
+	const uint32 Generation = DataRegistry.Generation + 1;
+	DataRegistry = FHouseDataRegistry();
+	DataRegistry.Generation = Generation;
+
+	// Alias tables hold resolved decoration classes
+	ClearDecorationAliasTables();
+}
+
+const FPatternData* UHouseEditorFunctionLibrary::FindPattern(FName PatternName)
+{
+	const FPatternData* const* Pattern = GetDataRegistry().Patterns.Find(PatternName);
+	return Pattern != nullptr ? *Pattern : nullptr;
+}
+
+// Shared, so a build keeps the pattern it started with even if the registry is rebuilt meanwhile
+TSharedPtr<const FCompiledPattern> UHouseEditorFunctionLibrary::FindCompiledPattern(FName PatternName)
+{
+	const TSharedPtr<const FCompiledPattern>* Pattern = GetDataRegistry().CompiledPatterns.Find(PatternName);
+	return Pattern != nullptr ? *Pattern : nullptr;
+}
+
+// False for a pattern held from before the last registry rebuild
+bool UHouseEditorFunctionLibrary::IsCompiledPatternCurrent(const FCompiledPattern& Pattern)
+{
+	return Pattern.Generation == DataRegistry.Generation;
+}
+
+const FHouseParamsTemplate* UHouseEditorFunctionLibrary::FindHouseTemplate(FName TemplateName)
+{
+	const FHouseParamsTemplate* const* Template = GetDataRegistry().Templates.Find(TemplateName);
+	return Template != nullptr ? *Template : nullptr;
+}
+
+const FRegisteredSegment* UHouseEditorFunctionLibrary::FindSegment(FName ClassName)
+{
+	return GetDataRegistry().Segments.Find(ClassName);
+}
+
+UDataTable* UHouseEditorFunctionLibrary::GetPatternDataTable()
+{
+	return GetDataRegistry().PatternTable.Get();
+}
+
+UDataTable* UHouseEditorFunctionLibrary::GetSegmentDataTable()
+{
+	return GetDataRegistry().SegmentTable.Get();
+}
+
+UDataTable* UHouseEditorFunctionLibrary::GetSegmentDecorationDataTable()
+{
+	return GetDataRegistry().DecorationTable.Get();
+}
+
+UDataTable* UHouseEditorFunctionLibrary::GetHouseParamsTemplateDataTable()
+{
+	return GetDataRegistry().TemplateTable.Get();
+}
+
+// SplitMix64 finalizer
+static uint64 MixRandomKey(uint64 Key)
+{
+	Key = (Key ^ (Key >> 30)) * 0xBF58476D1CE4E5B9ull;
+	Key = (Key ^ (Key >> 27)) * 0x94D049BB133111EBull;
+	return Key ^ (Key >> 31);
+}
+
+// Counter based random in [0, 1): value depends only on the seed and the position, not on call order or thread
+float UHouseEditorFunctionLibrary::GetDecorationRandom(int32 Seed, int WallIndex, int Floor, int SegmentIndex, int SocketIndex)
+{
+	uint64 Key = MixRandomKey(static_cast<uint32>(Seed));
+	for (const int Counter : { WallIndex, Floor, SegmentIndex, SocketIndex })
 	{
-		UE_LOG(LogTemp, Error, TEXT("House Params Template Data Table has wrong row struct, must be <HouseParamsTemplate>. Please, check Edge House Constructor plugin settings."));
-		return NULL;
+		Key = MixRandomKey(Key + 0x9E3779B97F4A7C15ull * (static_cast<uint64>(static_cast<uint32>(Counter)) + 1));
 	}
+	return static_cast<float>(Key >> 40) / static_cast<float>(1 << 24);
+}
 
-	return HouseParamsTemplateDataTable;
+// New positive seed for templates without one
+int32 UHouseEditorFunctionLibrary::MakeRandomSeed()
+{
+	const uint64 Key = MixRandomKey(FPlatformTime::Cycles64());
+	return FMath::Max(static_cast<int32>(Key & MAX_int32), 1);
 }
 
 TMap<FName, float> UHouseEditorFunctionLibrary::GetNormalizedDecorationWeights(FSegmentData SegmentData, FName SocketName, FSegmentDecorationsData GlobalWeights)
@@ -149,47 +379,663 @@ TMap<FName, float> UHouseEditorFunctionLibrary::GetNormalizedDecorationWeights(F
 	return WeightsMap;
 }
 
-TSubclassOf<ABaseSegment> UHouseEditorFunctionLibrary::GetSegmentClassByFName(FName ClassName)
+// O(1) pick: column from the integer part of RValue * Num, its threshold from the fractional part
+TSubclassOf<ABaseSegmentDecoration> FDecorationAliasTable::Sample(float RValue) const
 {
-	UDataTable* SegmentDataTable = GetSegmentDataTable();
-	if (SegmentDataTable->IsValidLowLevel() == false || SegmentDataTable->GetRowStruct() != FSegmentClassesData::StaticStruct())
+	if (Classes.Num() == 0)
 	{
-		UE_LOG(LogTemp, Warning, TEXT("Data table is not valid or has wrong RowStrut"));
 		return NULL;
 	}
+	const float Scaled = FMath::Clamp(RValue, 0.f, 1.f) * Classes.Num();
+	const int Column = FMath::Min(FMath::FloorToInt(Scaled), Classes.Num() - 1);
+	return (Scaled - Column < Probabilities[Column]) ? Classes[Column] : Classes[Aliases[Column]];
+}
+
+bool FDecorationAliasKey::operator==(const FDecorationAliasKey& Other) const
+{
+	return SegmentWeightsId == Other.SegmentWeightsId && GlobalWeightsId == Other.GlobalWeightsId;
+}
+
+uint32 GetTypeHash(const FDecorationAliasKey& Key)
+{
+	return HashCombine(GetTypeHash(Key.SegmentWeightsId), GetTypeHash(Key.GlobalWeightsId));
+}
+
+// Id of a weight set sorted by name: hashed lookup, a new set is stored once. Sets are dropped with the registry, ids are valid until its next rebuild.
+int32 UHouseEditorFunctionLibrary::InternDecorationWeights(TArrayView<const TPair<FName, float>> SortedWeights)
+{
+	check(IsInGameThread());
+
+	uint32 Hash = 0;
+	for (const TPair<FName, float>& Weight : SortedWeights)
+	{
+		Hash = HashCombine(Hash, HashCombine(GetTypeHash(Weight.Key), GetTypeHash(Weight.Value)));
+	}
+	for (auto It = DecorationWeightSetIds.CreateConstKeyIterator(Hash); It; ++It)
+	{
+		const TArray<TPair<FName, float>>& Set = DecorationWeightSets[It.Value()];
+		bool bSame = Set.Num() == SortedWeights.Num();
+		for (int32 Idx = 0; bSame && Idx < Set.Num(); Idx++)
+		{
+			bSame = Set[Idx] == SortedWeights[Idx];
+		}
+		if (bSame)
+		{
+			return It.Value();
+		}
+	}
+
+	const int32 Id = DecorationWeightSets.Emplace(SortedWeights.GetData(), SortedWeights.Num());
+	DecorationWeightSetIds.Add(Hash, Id);
+	return Id;
+}
+
+// Same weights get the same id whatever order they were added in
+int32 UHouseEditorFunctionLibrary::GetDecorationWeightsId(const FSegmentDecorationsData& Weights)
+{
+	TArray<TPair<FName, float>, TInlineAllocator<16>> Sorted;
+	for (const auto& Weight : Weights.SocketDecorationWeights)
+	{
+		Sorted.Emplace(Weight.Key, Weight.Value);
+	}
+	Sorted.Sort([](const TPair<FName, float>& A, const TPair<FName, float>& B) { return A.Key.FastLess(B.Key); });
+	return InternDecorationWeights(Sorted);
+}
+
+// Weights of the socket and of "Any" (None) summed per class, as GetNormalizedDecorationWeights does. Compiled patterns keep one per socket.
+int32 UHouseEditorFunctionLibrary::GetSegmentDecorationWeightsId(const FSegmentData& SegmentData, FName SocketName)
+{
+	TArray<TPair<FName, float>, TInlineAllocator<16>> Merged;
+	for (const FSegmentDecorationsData& SegmentDecorationsData : SegmentData.SegmentDecorationWeights)
+	{
+		if (SegmentDecorationsData.SocketName != SocketName && SegmentDecorationsData.SocketName != NAME_None)
+		{
+			continue;
+		}
+		for (const auto& Weight : SegmentDecorationsData.SocketDecorationWeights)
+		{
+			TPair<FName, float>* Existing = Merged.FindByPredicate([&Weight](const TPair<FName, float>& Pair) { return Pair.Key == Weight.Key; });
+			if (Existing != nullptr)
+			{
+				Existing->Value += Weight.Value;
+			}
+			else
+			{
+				Merged.Emplace(Weight.Key, Weight.Value);
+			}
+		}
+	}
+	Merged.Sort([](const TPair<FName, float>& A, const TPair<FName, float>& B) { return A.Key.FastLess(B.Key); });
+	return InternDecorationWeights(Merged);
+}
+
+// Vose alias table of segment and global weights summed and normalized like GetNormalizedDecorationWeights. Weights summing below 1 leave the rest to "no decoration".
+FDecorationAliasTable UHouseEditorFunctionLibrary::BuildDecorationAliasTable(int32 SegmentWeightsId, int32 GlobalWeightsId)
+{
+	// Copied - resolving classes below uses the registry
+	TArray<TPair<FName, float>, TInlineAllocator<16>> Combined(DecorationWeightSets[SegmentWeightsId]);
+	for (const TPair<FName, float>& Weight : DecorationWeightSets[GlobalWeightsId])
+	{
+		TPair<FName, float>* Existing = Combined.FindByPredicate([&Weight](const TPair<FName, float>& Pair) { return Pair.Key == Weight.Key; });
+		if (Existing != nullptr)
+		{
+			Existing->Value += Weight.Value;
+		}
+		else
+		{
+			Combined.Add(Weight);
+		}
+	}
+	float CombinedTotal = 0.f;
+	for (const TPair<FName, float>& Weight : Combined)
+	{
+		CombinedTotal += Weight.Value;
+	}
+	const float Scale = CombinedTotal > 1.f ? 1.f / CombinedTotal : 1.f;
+
+	// Outcomes with resolved classes, "none" is the last one if there is room left for it
+	FDecorationAliasTable Table;
+	TArray<float> Weights;
+	float TotalValue = 0.f;
+	for (const TPair<FName, float>& Weight : Combined)
+	{
+		if (Weight.Value > 0.f)
+		{
+			Table.Classes.Add(GetSegmentDecorationClassByFName(Weight.Key));
+			Weights.Add(Weight.Value * Scale);
+			TotalValue += Weight.Value * Scale;
+		}
+	}
+	if (TotalValue < 1.f)
+	{
+		Table.Classes.Add(NULL);
+		Weights.Add(1.f - TotalValue);
+	}
+
+	const int Num = Weights.Num();
+	Table.Probabilities.SetNumUninitialized(Num);
+	Table.Aliases.SetNumUninitialized(Num);
+	TArray<int> Small;
+	TArray<int> Large;
+	for (int Idx = 0; Idx < Num; Idx++)
+	{
+		Weights[Idx] *= Num;
+		(Weights[Idx] < 1.f ? Small : Large).Add(Idx);
+	}
+	while (Small.Num() > 0 && Large.Num() > 0)
+	{
+		const int Less = Small.Pop(false);
+		const int More = Large.Pop(false);
+		Table.Probabilities[Less] = Weights[Less];
+		Table.Aliases[Less] = More;
+		Weights[More] = (Weights[More] + Weights[Less]) - 1.f;
+		(Weights[More] < 1.f ? Small : Large).Add(More);
+	}
+	// Leftovers are 1 up to float error
+	for (const int Idx : Large)
+	{
+		Table.Probabilities[Idx] = 1.f;
+		Table.Aliases[Idx] = Idx;
+	}
+	for (const int Idx : Small)
+	{
+		Table.Probabilities[Idx] = 1.f;
+		Table.Aliases[Idx] = Idx;
+	}
+
+	return Table;
+}
+
+// Table of a segment socket and global weights ids, built on first pick. Lookup is a hash of two ints, nothing is allocated.
+TSubclassOf<ABaseSegmentDecoration> UHouseEditorFunctionLibrary::PickDecorationClass(int32 SegmentWeightsId, int32 GlobalWeightsId, float RValue)
+{
+	check(IsInGameThread());
+	check(DecorationWeightSets.IsValidIndex(SegmentWeightsId) && DecorationWeightSets.IsValidIndex(GlobalWeightsId));
+
+	const FDecorationAliasKey Key{ SegmentWeightsId, GlobalWeightsId };
+	if (const FDecorationAliasTable* Cached = DecorationAliasTables.Find(Key))
+	{
+		return Cached->Sample(RValue);
+	}
+
+	// Ids of a registry rebuilt while classes were resolved must not name a table of the new one
+	const uint32 Generation = DataRegistry.Generation;
+	FDecorationAliasTable Table = BuildDecorationAliasTable(SegmentWeightsId, GlobalWeightsId);
+	const TSubclassOf<ABaseSegmentDecoration> Picked = Table.Sample(RValue);
+	if (Generation == DataRegistry.Generation)
+	{
+		DecorationAliasTables.Add(Key, MoveTemp(Table));
+	}
+	return Picked;
+}
+
+// For segments that are not rows of a compiled pattern (previews) - same cached tables, ids are looked up first
+TSubclassOf<ABaseSegmentDecoration> UHouseEditorFunctionLibrary::PickDecorationClass(const FSegmentData& SegmentData, FName SocketName, const FSegmentDecorationsData& GlobalWeights, float RValue)
+{
+	const FSegmentDecorationsData EmptyData;
+	return PickDecorationClass(GetSegmentDecorationWeightsId(SegmentData, SocketName), GetDecorationWeightsId(SegmentData.bIgnoreGlobalDecorations ? EmptyData : GlobalWeights), RValue);
+}
+
+// Weight sets go too, so they don't pile up over a session. Ids held in compiled patterns are dropped with the registry.
+void UHouseEditorFunctionLibrary::ClearDecorationAliasTables()
+{
+	DecorationAliasTables.Empty();
+	DecorationWeightSets.Empty();
+	DecorationWeightSetIds.Empty();
+}
 
-	FSegmentClassesData* DataRow = SegmentDataTable->FindRow<FSegmentClassesData>(ClassName, FString());
-	if (DataRow == nullptr)
+TSubclassOf<ABaseSegment> UHouseEditorFunctionLibrary::GetSegmentClassByFName(FName ClassName)
+{
+	const FRegisteredSegment* Segment = FindSegment(ClassName);
+	if (Segment == nullptr)
 	{
 		return NULL;
 	}
-	return DataRow->SegmentClass;
+	return Segment->Class;
 }
 
 int UHouseEditorFunctionLibrary::GetSegmentSizeByFName(FName ClassName)
 {
-	TSubclassOf<ABaseSegment> SegmentClass = GetSegmentClassByFName(ClassName);
-	if (SegmentClass == NULL)
+	const FRegisteredSegment* Segment = FindSegment(ClassName);
+	if (Segment == nullptr)
 	{
 		return 0;
 	}
-
-	return SegmentClass.GetDefaultObject()->GetSegmentSize();;
+	return Segment->Size;
 }
 
 TSubclassOf<ABaseSegmentDecoration> UHouseEditorFunctionLibrary::GetSegmentDecorationClassByFName(FName DecorationClassName)
 {
-	UDataTable* SegmentDecorationDataTable = GetSegmentDecorationDataTable();
-	if (SegmentDecorationDataTable->IsValidLowLevel() == false) {
-		return NULL;
+	return GetDataRegistry().Decorations.FindRef(DecorationClassName);
+}
+
+// Meshes and scene components of a class the way a spawned actor would have them, relative to its root. Read once per class.
+const FHouseClassMetadata& UHouseEditorFunctionLibrary::GetClassMetadata(UClass* ActorClass)
+{
+	check(IsInGameThread());
+
+	if (const FHouseClassMetadata* Cached = ClassMetadataCache.Find(ActorClass))
+	{
+		return *Cached;
+	}
+	FHouseClassMetadata& Metadata = ClassMetadataCache.Add(ActorClass);
+	if (ActorClass == nullptr || !ActorClass->IsChildOf<AActor>())
+	{
+		return Metadata;
 	}
 
-	FSegmentDecorationClassesData* DataRow = SegmentDecorationDataTable->FindRow<FSegmentDecorationClassesData>(DecorationClassName, FString());
-	if (DataRow == nullptr)
+	const auto AddComponent = [&Metadata, ActorClass](const USceneComponent* Component, FName Name, const FTransform& Transform)
 	{
-		return NULL;
+		Metadata.SceneTransforms.Add(Name, Transform);
+
+		const UStaticMeshComponent* MeshComponent = Cast<UStaticMeshComponent>(Component);
+		if (MeshComponent != nullptr && MeshComponent->GetStaticMesh() != nullptr)
+		{
+			FHouseMeshPlacement& Placement = Metadata.Meshes.AddDefaulted_GetRef();
+			Placement.Mesh = MeshComponent->GetStaticMesh();
+			Placement.Transform = Transform;
+			Placement.Materials = MeshComponent->OverrideMaterials;
+			Placement.SourceClass = ActorClass;
+		}
+	};
+
+	// Native components
+	const AActor* DefaultActor = ActorClass->GetDefaultObject<AActor>();
+	const USceneComponent* NativeRoot = DefaultActor->GetRootComponent();
+	TInlineComponentArray<USceneComponent*> NativeComponents;
+	DefaultActor->GetComponents(NativeComponents);
+	for (const USceneComponent* Component : NativeComponents)
+	{
+		FTransform Transform = FTransform::Identity;
+		for (const USceneComponent* Parent = Component; Parent != nullptr && Parent != NativeRoot; Parent = Parent->GetAttachParent())
+		{
+			Transform = Transform * Parent->GetRelativeTransform();
+		}
+		AddComponent(Component, Component->GetFName(), Transform);
+	}
+
+	// Blueprint components, parent classes first so inherited parents are known. Root of the actor has no offset of its own.
+	UBlueprintGeneratedClass* ActualClass = Cast<UBlueprintGeneratedClass>(ActorClass);
+	TArray<const UBlueprintGeneratedClass*> BlueprintClasses;
+	UBlueprintGeneratedClass::GetGeneratedClassesHierarchy(ActorClass, BlueprintClasses);
+	bool bHasRoot = NativeRoot != nullptr;
+
+	TFunction<void(const USCS_Node*, const FTransform&, bool)> AddNode = [&](const USCS_Node* Node, const FTransform& ParentTransform, bool bIsRoot)
+	{
+		const USceneComponent* Template = Cast<USceneComponent>(Node->GetActualComponentTemplate(ActualClass));
+		if (Template == nullptr)
+		{
+			return;
+		}
+		const FTransform Transform = bIsRoot ? FTransform::Identity : Template->GetRelativeTransform() * ParentTransform;
+		AddComponent(Template, Node->GetVariableName(), Transform);
+
+		for (const USCS_Node* Child : Node->GetChildNodes())
+		{
+			AddNode(Child, Transform, false);
+		}
+	};
+
+	for (int ClassIdx = BlueprintClasses.Num() - 1; ClassIdx >= 0; ClassIdx--)
+	{
+		const USimpleConstructionScript* Script = BlueprintClasses[ClassIdx]->SimpleConstructionScript;
+		if (Script == nullptr)
+		{
+			continue;
+		}
+		for (const USCS_Node* Node : Script->GetRootNodes())
+		{
+			const FTransform* ParentTransform = Metadata.SceneTransforms.Find(Node->ParentComponentOrVariableName);
+			AddNode(Node, ParentTransform != nullptr ? *ParentTransform : FTransform::Identity, ParentTransform == nullptr && !bHasRoot);
+			bHasRoot = true;
+		}
+	}
+
+	return Metadata;
+}
+
+void UHouseEditorFunctionLibrary::ClearClassMetadataCache()
+{
+	ClassMetadataCache.Empty();
+}
+
+// Blueprint compiles and reloads replace classes and their defaults. Cached metadata and segment sizes and sockets in the registry describe the old ones.
+static FDelayedAutoRegisterHelper InvalidateOnClassesReplaced(EDelayedRegisterRunPhase::ObjectSystemReady, []
+{
+	FCoreUObjectDelegates::OnObjectsReplaced.AddLambda([](const TMap<UObject*, UObject*>& ReplacedObjects)
+	{
+		for (const auto& Replaced : ReplacedObjects)
+		{
+			if (Replaced.Key != nullptr && (Replaced.Key->IsA<UClass>() || Replaced.Key->HasAnyFlags(RF_ClassDefaultObject)))
+			{
+				UHouseEditorFunctionLibrary::ClearClassMetadataCache();
+				UHouseEditorFunctionLibrary::InvalidateDataRegistry();
+				return;
+			}
+		}
+	});
+});
+
+// Same as UMeshComponent::GetMaterial - override first, mesh material otherwise
+UMaterialInterface* UHouseEditorFunctionLibrary::GetPlacementMaterial(const FHouseMeshPlacement& Placement, int MaterialIndex)
+{
+	if (Placement.Materials.IsValidIndex(MaterialIndex) && Placement.Materials[MaterialIndex] != nullptr)
+	{
+		return Placement.Materials[MaterialIndex];
+	}
+	return Placement.Mesh != nullptr ? Placement.Mesh->GetMaterial(MaterialIndex) : nullptr;
+}
+
+// Same as UStaticMeshComponent::SetMaterialByName
+void UHouseEditorFunctionLibrary::SetPlacementMaterialByName(FHouseMeshPlacement& Placement, FName SlotName, UMaterialInterface* Material)
+{
+	const int MaterialIndex = Placement.Mesh != nullptr ? Placement.Mesh->GetMaterialIndex(SlotName) : INDEX_NONE;
+	if (MaterialIndex == INDEX_NONE || Material == nullptr)
+	{
+		return;
+	}
+	if (Placement.Materials.Num() <= MaterialIndex)
+	{
+		Placement.Materials.SetNumZeroed(MaterialIndex + 1);
+	}
+	Placement.Materials[MaterialIndex] = Material;
+}
+
+// Pooled actor of the class from the same world, or a new one with deferred construction. Either way FinishElement must follow.
+AActor* UHouseEditorFunctionLibrary::AcquireElement(UWorld* World, UClass* Class, AActor* Owner)
+{
+	if (World == nullptr || Class == nullptr)
+	{
+		return nullptr;
+	}
+
+	if (TArray<TWeakObjectPtr<AActor>>* Pooled = ElementPool.Find(Class))
+	{
+		for (int Index = Pooled->Num() - 1; Index >= 0; Index--)
+		{
+			AActor* Element = (*Pooled)[Index].Get();
+			if (Element != nullptr && !Element->IsPendingKill() && Element->GetWorld() != World)
+			{
+				continue;
+			}
+			Pooled->RemoveAtSwap(Index);
+			DEC_DWORD_STAT(STAT_EDGEHouses_PooledElements);
+			if (Element == nullptr || Element->IsPendingKill())
+			{
+				continue;
+			}
+
+			Element->ClearFlags(RF_Transient);
+			Element->SetOwner(Owner);
+			Element->SetActorHiddenInGame(false);
+			Element->SetActorEnableCollision(Class->GetDefaultObject<AActor>()->GetActorEnableCollision());
+#if WITH_EDITOR
+			Element->SetIsTemporarilyHiddenInEditor(false);
+#endif
+			INC_DWORD_STAT(STAT_EDGEHouses_ElementsReused);
+			return Element;
+		}
+	}
+
+	INC_DWORD_STAT(STAT_EDGEHouses_ElementsSpawned);
+	return World->SpawnActorDeferred<AActor>(Class, FTransform(), Owner);
+}
+
+// Finishes spawning of a new element, pooled ones only run their construction again
+void UHouseEditorFunctionLibrary::FinishElement(AActor* Element, const FTransform& Transform)
+{
+	if (Element == nullptr)
+	{
+		return;
+	}
+	if (!Element->IsActorInitialized())
+	{
+		Element->FinishSpawning(Transform);
+		return;
+	}
+	// Blueprint construction runs again as well, with components it made the last time destroyed first
+	Element->SetActorTransform(Transform);
+#if WITH_EDITOR
+	Element->RerunConstructionScripts();
+#else
+	Element->DestroyConstructedComponents();
+	Element->ExecuteConstruction(Transform, nullptr, nullptr);
+#endif
+}
+
+// Hides the element and keeps it for the next rebuild. Pooled actors are transient, so they are never saved with the level.
+void UHouseEditorFunctionLibrary::ReleaseElement(AActor* Element)
+{
+	if (Element == nullptr || Element->IsPendingKill())
+	{
+		return;
+	}
+
+	TArray<TWeakObjectPtr<AActor>>& Pooled = ElementPool.FindOrAdd(Element->GetClass());
+	if (Pooled.Num() >= CVarElementPoolSize.GetValueOnGameThread())
+	{
+		Element->Destroy();
+		return;
+	}
+
+	Element->DetachFromActor(FDetachmentTransformRules::KeepRelativeTransform);
+	Element->SetOwner(nullptr);
+	Element->SetActorHiddenInGame(true);
+	Element->SetActorEnableCollision(false);
+#if WITH_EDITOR
+	Element->SetIsTemporarilyHiddenInEditor(true);
+#endif
+	// Material overrides of one house must not show up on the next one
+	TInlineComponentArray<UMeshComponent*> Meshes(Element);
+	for (UMeshComponent* Mesh : Meshes)
+	{
+		Mesh->EmptyOverrideMaterials();
+	}
+	Element->SetFlags(RF_Transient);
+
+	Pooled.Add(Element);
+	INC_DWORD_STAT(STAT_EDGEHouses_PooledElements);
+}
+
+// Destroys pooled elements of World, of every world if it is null
+void UHouseEditorFunctionLibrary::ClearElementPool(UWorld* World)
+{
+	for (auto It = ElementPool.CreateIterator(); It; ++It)
+	{
+		TArray<TWeakObjectPtr<AActor>>& Pooled = It.Value();
+		for (int Index = Pooled.Num() - 1; Index >= 0; Index--)
+		{
+			AActor* Element = Pooled[Index].Get();
+			if (Element != nullptr && World != nullptr && Element->GetWorld() != World)
+			{
+				continue;
+			}
+			if (Element != nullptr && !Element->IsPendingKill())
+			{
+				Element->Destroy();
+			}
+			Pooled.RemoveAtSwap(Index);
+			DEC_DWORD_STAT(STAT_EDGEHouses_PooledElements);
+		}
+		if (Pooled.Num() == 0)
+		{
+			It.RemoveCurrent();
+		}
+	}
+}
+
+// Pooled elements go with their level, and are not left hidden in it when it is saved
+static FDelayedAutoRegisterHelper ClearElementPoolOnCleanup(EDelayedRegisterRunPhase::EndOfEngineInit, []
+{
+	FWorldDelegates::OnWorldCleanup.AddLambda([](UWorld* World, bool bSessionEnded, bool bCleanupResources)
+	{
+		UHouseEditorFunctionLibrary::ClearElementPool(World);
+	});
+#if WITH_EDITOR
+	FEditorDelegates::PreSaveWorld.AddLambda([](uint32 SaveFlags, UWorld* World)
+	{
+		UHouseEditorFunctionLibrary::ClearElementPool(World);
+	});
+#endif
+});
+
+// Static mesh components of an element actor matched to placements. Components of the previous construction are reused, spare ones are unregistered and wait for a bigger one.
+// Placements come from GetPlacements of the element classes - meshes in actor space, which virtual house builds read from the CDO as well.
+// Components are made as transient instance components: rerunning construction destroys only script-made ones, and they are never saved with the actor.
+void UHouseEditorFunctionLibrary::ApplyPlacements(AActor* Owner, const TArray<FHouseMeshPlacement>& Placements, TArray<UStaticMeshComponent*>& Components, FName NamePrefix)
+{
+	// Components copied along with a duplicated actor still belong to the original. Destroyed ones mean the next build cannot reuse them.
+	int DestroyedNum = 0;
+	Components.RemoveAll([Owner, &DestroyedNum](const UStaticMeshComponent* Component)
+	{
+		DestroyedNum += (Component != nullptr && Component->IsPendingKill()) ? 1 : 0;
+		return Component == nullptr || Component->IsPendingKill() || Component->GetOwner() != Owner;
+	});
+	ensureMsgf(DestroyedNum == 0, TEXT("~~ %i %s components of %s were destroyed since the last construction and are not reused"), DestroyedNum, *NamePrefix.ToString(), *Owner->GetName());
+
+	for (int Index = 0; Index < Placements.Num(); Index++)
+	{
+		UStaticMeshComponent* Component;
+		if (Components.IsValidIndex(Index))
+		{
+			Component = Components[Index];
+			Component->EmptyOverrideMaterials();
+			INC_DWORD_STAT(STAT_EDGEHouses_ComponentsReused);
+		}
+		else
+		{
+			const FName Name = MakeUniqueObjectName(Owner, UStaticMeshComponent::StaticClass(), NamePrefix);
+			Component = NewObject<UStaticMeshComponent>(Owner, UStaticMeshComponent::StaticClass(), Name, RF_Transient);
+			Component->CreationMethod = EComponentCreationMethod::Instance;
+			Component->SetupAttachment(Owner->GetRootComponent());
+			Components.Add(Component);
+			INC_DWORD_STAT(STAT_EDGEHouses_ComponentsCreated);
+		}
+		Component->SetRelativeTransform(Placements[Index].Transform);
+		if (!Component->IsRegistered())
+		{
+			Component->RegisterComponent();
+		}
+		Component->SetStaticMesh(Placements[Index].Mesh);
+	}
+
+	for (int Index = Placements.Num(); Index < Components.Num(); Index++)
+	{
+		if (Components[Index]->IsRegistered())
+		{
+			Components[Index]->UnregisterComponent();
+		}
+	}
+}
+
+// Cull distances of the closest element class set in plugin settings, zero means never culled
+FInt32Interval UHouseEditorFunctionLibrary::GetElementCullDistances(const UClass* ElementClass)
+{
+	const TMap<TSubclassOf<AActor>, FInt32Interval>& CullDistances = GetDefault<UEdgeHouseConstructorSettings>()->ElementCullDistances;
+	for (const UClass* Class = ElementClass; Class != nullptr; Class = Class->GetSuperClass())
+	{
+		if (const FInt32Interval* Distances = CullDistances.Find(const_cast<UClass*>(Class)))
+		{
+			return *Distances;
+		}
+	}
+	return FInt32Interval(0, 0);
+}
+
+// Player camera in game, otherwise whatever was rendered last frame - editor viewports included. False if nobody looks yet.
+bool UHouseEditorFunctionLibrary::GetViewLocation(const UWorld* World, FVector& OutLocation)
+{
+	if (World == nullptr)
+	{
+		return false;
+	}
+	if (const APlayerController* Controller = World->GetFirstPlayerController())
+	{
+		FRotator ViewRotation;
+		Controller->GetPlayerViewPoint(OutLocation, ViewRotation);
+		return true;
+	}
+	if (World->ViewLocationsRenderedLastFrame.Num() > 0)
+	{
+		OutLocation = World->ViewLocationsRenderedLastFrame[0];
+		return true;
+	}
+	return false;
+}
+
+// Instances sharing a mesh are merged only when they are drawn the same way
+struct FInstancedMeshKey
+{
+	UStaticMesh* Mesh;
+	TArray<UMaterialInterface*> Materials;
+	FInt32Interval CullDistances;
+
+	bool operator==(const FInstancedMeshKey& Other) const
+	{
+		return Mesh == Other.Mesh && Materials == Other.Materials && CullDistances.Min == Other.CullDistances.Min && CullDistances.Max == Other.CullDistances.Max;
+	}
+
+	friend uint32 GetTypeHash(const FInstancedMeshKey& Key)
+	{
+		uint32 Hash = HashCombine(GetTypeHash(Key.Mesh), HashCombine(GetTypeHash(Key.CullDistances.Min), GetTypeHash(Key.CullDistances.Max)));
+		for (const UMaterialInterface* Material : Key.Materials)
+		{
+			Hash = HashCombine(Hash, GetTypeHash(Material));
+		}
+		return Hash;
+	}
+};
+
+// One HISM per mesh, material set and cull distances. Placements are relative to the owner, so no element actors are needed.
+void UHouseEditorFunctionLibrary::InstantiatePlacements(AActor* Owner, const TArray<FHouseMeshPlacement>& Placements, TArray<UInstancedStaticMeshComponent*>& OutComponents)
+{
+	if (Owner == nullptr || Owner->GetRootComponent() == nullptr)
+	{
+		return;
+	}
+
+	TMap<FInstancedMeshKey, TArray<FTransform>> Batches;
+	TMap<const UClass*, FInt32Interval> ClassCullDistances;
+	for (const FHouseMeshPlacement& Placement : Placements)
+	{
+		if (Placement.Mesh == nullptr)
+		{
+			continue;
+		}
+
+		FInstancedMeshKey Key;
+		Key.Mesh = Placement.Mesh;
+		Key.Materials.SetNumUninitialized(Placement.Mesh->GetStaticMaterials().Num());
+		for (int MatIdx = 0; MatIdx < Key.Materials.Num(); MatIdx++)
+		{
+			Key.Materials[MatIdx] = GetPlacementMaterial(Placement, MatIdx);
+		}
+		const FInt32Interval* CullDistances = ClassCullDistances.Find(Placement.SourceClass);
+		Key.CullDistances = CullDistances != nullptr ? *CullDistances : ClassCullDistances.Add(Placement.SourceClass, GetElementCullDistances(Placement.SourceClass));
+
+		Batches.FindOrAdd(MoveTemp(Key)).Add(Placement.Transform);
+	}
+
+	OutComponents.Reserve(OutComponents.Num() + Batches.Num());
+	for (const auto& Batch : Batches)
+	{
+		const FInstancedMeshKey& Key = Batch.Key;
+		const FName Name = MakeUniqueObjectName(Owner, UHierarchicalInstancedStaticMeshComponent::StaticClass(), Key.Mesh->GetFName());
+		UHierarchicalInstancedStaticMeshComponent* Instances = NewObject<UHierarchicalInstancedStaticMeshComponent>(Owner, Name);
+		Instances->SetStaticMesh(Key.Mesh);
+		for (int MatIdx = 0; MatIdx < Key.Materials.Num(); MatIdx++)
+		{
+			Instances->SetMaterial(MatIdx, Key.Materials[MatIdx]);
+		}
+		Instances->SetCullDistances(Key.CullDistances.Min, Key.CullDistances.Max);
+		Instances->SetupAttachment(Owner->GetRootComponent());
+		Instances->RegisterComponent();
+		Owner->AddInstanceComponent(Instances);
+
+		// Tree is built once for the whole batch
+		Instances->AddInstances(Batch.Value, false);
+		OutComponents.Add(Instances);
 	}
-	return DataRow->SegmentDecorationClass;
 }
 
 void UHouseEditorFunctionLibrary::FindSegmentDecorationDataBySocket(FSegmentDecorationsData& OutDecorationData, FSegmentData& InSegmentData, FName SocketName)
@@ -335,6 +1181,12 @@ void UHouseEditorFunctionLibrary::CheckOutAndSave(UObject* Asset, FString SavePa
 	}
 	Package->MarkPackageDirty();
 
+	// Rows were added or removed in code - let the registry know
+	if (UDataTable* DataTable = Cast<UDataTable>(Asset))
+	{
+		DataTable->HandleDataTableChanged();
+	}
+
 	bool bMarkToAddLater = false;
 	
 	if (USourceControlHelpers::IsAvailable())
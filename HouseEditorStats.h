@@ -0,0 +1,8 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "Stats/Stats.h"
+
+// One group for the house editor stats declared in its .cpp files
+DECLARE_STATS_GROUP(TEXT("EDGE Houses"), STATGROUP_EDGEHouses, STATCAT_Advanced);
@@ -0,0 +1,287 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "HouseEditor/HouseGenerationPipeline.h"
+#include "HouseEditor/HouseEditor.h"
+#include "HouseEditor/HouseEditorStats.h"
+
+#include "Async/Async.h"
+#include "Containers/Ticker.h"
+#include "EngineUtils.h"
+#include "HAL/FileManager.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/QueuedThreadPool.h"
+#include "RuntimeMesh/EDGEMeshUtility.h"
+#include "RuntimeMesh/EDGERuntimeMeshProvider.h"
+
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Pipeline Waiting Houses"), STAT_EDGEHouses_PipelineWaiting, STATGROUP_EDGEHouses);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Pipeline Jobs In Flight"), STAT_EDGEHouses_PipelineInFlight, STATGROUP_EDGEHouses);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Pipeline Houses Generated"), STAT_EDGEHouses_PipelineGenerated, STATGROUP_EDGEHouses);
+DECLARE_FLOAT_ACCUMULATOR_STAT(TEXT("Pipeline Houses Per Second"), STAT_EDGEHouses_PipelineThroughput, STATGROUP_EDGEHouses);
+DECLARE_CYCLE_STAT(TEXT("Pipeline Extract"), STAT_EDGEHouses_PipelineExtract, STATGROUP_EDGEHouses);
+DECLARE_CYCLE_STAT(TEXT("Pipeline Finish"), STAT_EDGEHouses_PipelineFinish, STATGROUP_EDGEHouses);
+
+static TAutoConsoleVariable<int32> CVarPipelineMaxJobsInFlight(
+	TEXT("EDGE.Houses.Pipeline.MaxJobsInFlight"),
+	8,
+	TEXT("How many extracted houses may wait for or run merging, file writing and conversion on workers. Extraction pauses above it."));
+
+static TAutoConsoleVariable<float> CVarPipelineExtractBudgetMs(
+	TEXT("EDGE.Houses.Pipeline.ExtractBudgetMs"),
+	8.f,
+	TEXT("Game thread time per frame given to extracting house meshes for the generation pipeline, in ms. At least one house is extracted every frame."));
+
+static FAutoConsoleCommandWithWorld CmdGenerateHouses(
+	TEXT("EDGE.Houses.Generate"),
+	TEXT("Generates mesh data of every dirty or empty house in the current world, stages of different houses overlap. Prints houses per second when done."),
+	FConsoleCommandWithWorldDelegate::CreateStatic(&EDGEHouseGenerationPipeline::GenerateWorld));
+
+TArray<EDGEHouseGenerationPipeline::FJobPtr> EDGEHouseGenerationPipeline::WaitingJobs;
+int32 EDGEHouseGenerationPipeline::JobsInFlight = 0;
+FDelegateHandle EDGEHouseGenerationPipeline::TickerHandle;
+EDGEHouseGenerationPipeline::FBatchStats EDGEHouseGenerationPipeline::Batch;
+
+// Followers share the resolved template of House and take its mesh data from the cache once it is there
+void EDGEHouseGenerationPipeline::Enqueue(AHouseEditor* House, const TArray<AHouseEditor*>& Followers)
+{
+	check(IsInGameThread());
+
+	if (House == nullptr || House->GetRMCProvider() == nullptr)
+	{
+		return;
+	}
+	for (const FJobPtr& Job : WaitingJobs)
+	{
+		if (Job->House == House)
+		{
+			return;
+		}
+	}
+
+	if (IsIdle())
+	{
+		Batch = FBatchStats();
+		Batch.StartTime = FPlatformTime::Seconds();
+	}
+
+	// Cache key is taken when the house is extracted, it may be edited while waiting
+	FJobPtr Job = MakeShared<FJob, ESPMode::ThreadSafe>();
+	Job->House = House;
+	for (AHouseEditor* Follower : Followers)
+	{
+		Job->Followers.Add(Follower);
+	}
+	WaitingJobs.Add(Job);
+	INC_DWORD_STAT(STAT_EDGEHouses_PipelineWaiting);
+
+	if (!TickerHandle.IsValid())
+	{
+		TickerHandle = FTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateStatic(&EDGEHouseGenerationPipeline::Tick));
+	}
+}
+
+// One job per resolved template, like DeduplicateHouses
+void EDGEHouseGenerationPipeline::GenerateWorld(UWorld* World)
+{
+	if (World == nullptr)
+	{
+		return;
+	}
+
+	TMap<FString, TArray<AHouseEditor*>> Groups;
+	for (TActorIterator<AHouseEditor> It(World); It; ++It)
+	{
+		AHouseEditor* House = *It;
+		if (House->IsPendingKill() || House->GetRMCProvider() == nullptr)
+		{
+			continue;
+		}
+		if (House->NeedsMeshData())
+		{
+			Groups.FindOrAdd(House->GetMeshCacheKey()).Add(House);
+		}
+	}
+
+	for (auto& Group : Groups)
+	{
+		AHouseEditor* House = Group.Value[0];
+		Group.Value.RemoveAt(0);
+		Enqueue(House, Group.Value);
+	}
+
+	UE_LOG(LogTemp, Display, TEXT("~~ Generation pipeline: %i unique houses of %s queued."), Groups.Num(), *World->GetName());
+}
+
+bool EDGEHouseGenerationPipeline::IsIdle()
+{
+	return WaitingJobs.Num() == 0 && JobsInFlight == 0;
+}
+
+// Game thread stage: placements and raw sections need UObjects (render data, materials table), so they are read here within budget
+bool EDGEHouseGenerationPipeline::Tick(float DeltaTime)
+{
+	SCOPE_CYCLE_COUNTER(STAT_EDGEHouses_PipelineExtract);
+
+	const int32 MaxJobsInFlight = FMath::Max(CVarPipelineMaxJobsInFlight.GetValueOnGameThread(), 1);
+	const double EndTime = FPlatformTime::Seconds() + CVarPipelineExtractBudgetMs.GetValueOnGameThread() / 1000.0;
+	bool bFirst = true;
+
+	// Full worker queue holds extraction back, so raw sections don't pile up in memory
+	while (WaitingJobs.Num() > 0 && JobsInFlight < MaxJobsInFlight && (bFirst || FPlatformTime::Seconds() < EndTime))
+	{
+		bFirst = false;
+		const FJobPtr Job = WaitingJobs[0];
+		WaitingJobs.RemoveAt(0, 1, false);
+		DEC_DWORD_STAT(STAT_EDGEHouses_PipelineWaiting);
+
+		AHouseEditor* House = PromoteLeader(*Job);
+		if (House == nullptr)
+		{
+			continue;
+		}
+
+		const double StartTime = FPlatformTime::Seconds();
+		Job->FileName = House->GetMeshCacheKey();
+		TArray<string> DirtySectionKeys;
+		bool bAnyPartDirty = false;
+		if (!House->ExtractMeshData(Job->RawSections, Job->CollisionBoxes, DirtySectionKeys, bAnyPartDirty))
+		{
+			UE_LOG(LogTemp, Error, TEXT("[%s] House couldn't be rebuilt. Skipped by generation pipeline."), *House->GetName());
+			continue;
+		}
+		Job->EditCount = House->GetMeshEditCount();
+		Job->ExtractSeconds = FPlatformTime::Seconds() - StartTime;
+		Batch.ExtractSeconds += Job->ExtractSeconds;
+
+		JobsInFlight++;
+		INC_DWORD_STAT(STAT_EDGEHouses_PipelineInFlight);
+		StartWorkerStage(Job);
+	}
+
+	if (IsIdle())
+	{
+		TickerHandle.Reset();
+		return false;
+	}
+	return true;
+}
+
+// Leader gone - a follower still there takes over, they share its resolved template. Null if none is left.
+AHouseEditor* EDGEHouseGenerationPipeline::PromoteLeader(FJob& Job)
+{
+	AHouseEditor* House = Job.House.Get();
+	while ((House == nullptr || House->IsPendingKill()) && Job.Followers.Num() > 0)
+	{
+		Job.House = Job.Followers[0];
+		Job.Followers.RemoveAt(0);
+		House = Job.House.Get();
+	}
+	return House != nullptr && !House->IsPendingKill() ? House : nullptr;
+}
+
+// Merging, file writing and geometry conversion are pure data. Jobs run on different workers, so one house is written while another is merged.
+// The file goes to a temporary path, FinishJob moves it into place only if the result is still wanted.
+void EDGEHouseGenerationPipeline::StartWorkerStage(const FJobPtr& Job)
+{
+	AsyncPool(*GThreadPool, [Job]()
+	{
+		const double StartTime = FPlatformTime::Seconds();
+		UEDGEMeshUtility::MergeSections(Job->RawSections);
+		UEDGEMeshUtility::WriteMeshDataToTempFile(Job->FileName, Job->RawSections, Job->CollisionBoxes, Job->TempFilePath);
+
+		Job->Sections.SetNum(Job->RawSections.size());
+		for (int SectionIdx = 0; SectionIdx < Job->RawSections.size(); SectionIdx++)
+		{
+			UEDGEMeshUtility::ConvertRawSectionGeometry(Job->RawSections[SectionIdx], Job->Sections[SectionIdx]);
+		}
+		Job->WorkerSeconds = FPlatformTime::Seconds() - StartTime;
+
+		AsyncTask(ENamedThreads::GameThread, [Job]()
+		{
+			FinishJob(Job);
+		});
+	});
+}
+
+// Game thread stage: materials, provider and runtime mesh are UObjects. Collision is cooked async by the runtime mesh itself.
+void EDGEHouseGenerationPipeline::FinishJob(const FJobPtr& Job)
+{
+	SCOPE_CYCLE_COUNTER(STAT_EDGEHouses_PipelineFinish);
+
+	JobsInFlight--;
+	DEC_DWORD_STAT(STAT_EDGEHouses_PipelineInFlight);
+	Batch.WorkerSeconds += Job->WorkerSeconds;
+
+	// House edited or given data some other way since extraction - result is out of date. If it was destroyed, a follower takes the result.
+	AHouseEditor* House = Job->House.Get();
+	const bool bLeaderGone = House == nullptr || House->IsPendingKill();
+	if (!bLeaderGone && (House->GetMeshEditCount() != Job->EditCount || House->GetMeshCacheKey() != Job->FileName))
+	{
+		UE_LOG(LogTemp, Display, TEXT("[%s] House changed while its mesh data was generated. Generation pipeline result dropped."), *House->GetName());
+		House = nullptr;
+	}
+	else if (bLeaderGone)
+	{
+		// Followers retemplated meanwhile don't qualify
+		for (House = PromoteLeader(*Job); House != nullptr && House->GetMeshCacheKey() != Job->FileName; House = PromoteLeader(*Job))
+		{
+			Job->House = nullptr;
+		}
+	}
+
+	if (House == nullptr)
+	{
+		if (!Job->TempFilePath.IsEmpty())
+		{
+			IFileManager::Get().Delete(*Job->TempFilePath, false, false, true);
+		}
+	}
+	else
+	{
+		const double StartTime = FPlatformTime::Seconds();
+		if (!Job->TempFilePath.IsEmpty())
+		{
+			UEDGEMeshUtility::CommitMeshDataFile(Job->FileName, Job->TempFilePath);
+		}
+		TArray<UMaterialInterface*> Materials;
+		UEDGEMeshUtility::ResolveSectionMaterials(Job->RawSections, Job->Sections, Materials);
+
+		const FName Name = *FString::Printf(TEXT("%s"), *Job->FileName);
+		House->SetGeneratedProvider(Name, Job->Sections, Materials, Job->CollisionBoxes, Job->ExtractSeconds + Job->WorkerSeconds);
+		House->FinishMeshData();
+		House->ShowGeneratedMesh(true);
+
+		// Same key, so they find the provider in the cache
+		for (const TWeakObjectPtr<AHouseEditor>& WeakFollower : Job->Followers)
+		{
+			AHouseEditor* Follower = WeakFollower.Get();
+			if (Follower != nullptr && !Follower->IsPendingKill() && Follower->GetMeshCacheKey() == Job->FileName)
+			{
+				Follower->TakeCachedMeshData();
+				Follower->ShowGeneratedMesh(true);
+				Batch.NumHouses++;
+			}
+		}
+
+		Batch.FinishSeconds += FPlatformTime::Seconds() - StartTime;
+		Batch.NumHouses++;
+		Batch.NumGenerated++;
+		INC_DWORD_STAT(STAT_EDGEHouses_PipelineGenerated);
+	}
+
+	if (IsIdle())
+	{
+		ReportBatch();
+	}
+}
+
+void EDGEHouseGenerationPipeline::ReportBatch()
+{
+	const double Seconds = FMath::Max(FPlatformTime::Seconds() - Batch.StartTime, SMALL_NUMBER);
+	const float HousesPerSecond = Batch.NumHouses / Seconds;
+	SET_FLOAT_STAT(STAT_EDGEHouses_PipelineThroughput, HousesPerSecond);
+
+	// Stage times are summed over houses - their total above wall time is what overlapping saved
+	UE_LOG(LogTemp, Display, TEXT("~~ Generation pipeline done: %i houses (%i generated) in %.2f s, %.1f houses/s. Extract %.2f s, workers %.2f s, finish %.2f s."),
+		Batch.NumHouses, Batch.NumGenerated, Seconds, HousesPerSecond, Batch.ExtractSeconds, Batch.WorkerSeconds, Batch.FinishSeconds);
+}
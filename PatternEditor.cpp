@@ -78,9 +78,9 @@ void APatternEditor::ClearAll(bool bClearClasses)
 		Element->GetAttachedActors(Decorations);
 		for (AActor* Actor : Decorations)
 		{
-			Actor->Destroy();
+			UHouseEditorFunctionLibrary::ReleaseElement(Actor);
 		}
-		Element->Destroy();
+		UHouseEditorFunctionLibrary::ReleaseElement(Element);
 	}
 	OffsetsV.Empty();
 	OffsetsV.Add(0);
@@ -214,11 +214,12 @@ void APatternEditor::BuildElement(int SegmentHPos, int SegmentVPos, FSegmentData
 		return;
 	}
 
-	NewActor = GetWorld()->SpawnActor<ABaseSegment>(NewActorClass, FVector(OffsetsH[SegmentHPos], 0, OffsetsV[SegmentVPos]), FRotator(0));
+	NewActor = Cast<ABaseSegment>(UHouseEditorFunctionLibrary::AcquireElement(GetWorld(), NewActorClass, this));
 	if (NewActor == NULL) {
 		UE_LOG(LogTemp, Warning, TEXT("Actor was not created!"));
 		return;
 	}
+	UHouseEditorFunctionLibrary::FinishElement(NewActor, FTransform(FVector(OffsetsH[SegmentHPos], 0, OffsetsV[SegmentVPos])));
 	NewActor->AttachToActor(this, FAttachmentTransformRules::KeepRelativeTransform);			// TODO: remake offests calculation, couse its BS for now
 
 	TArray<TEnumAsByte<EMaterialSlot>> Keys;
@@ -234,35 +235,24 @@ void APatternEditor::BuildElement(int SegmentHPos, int SegmentVPos, FSegmentData
 	
 	if (NewSegment.SegmentDecorationWeights.Num() > 0 && Sockets.Num() > 0)
 	{
-		for (USceneComponent* Socket : Sockets)
+		// Preview is seeded by pattern name, so it stays the same between rebuilds and editor sessions (FName hashes are not)
+		const int32 Seed = static_cast<int32>(FCrc::StrCrc32(*PatternName.ToString()));
+		for (int SocketIndex = 0; SocketIndex < Sockets.Num(); SocketIndex++)
 		{
-			float RValue = static_cast<float>(rand()) / static_cast<float>(RAND_MAX);			// TODO: make random with seed that may (or may not) be saved
-			float Threshold = 0.f;
+			USceneComponent* Socket = Sockets[SocketIndex];
+			float RValue = UHouseEditorFunctionLibrary::GetDecorationRandom(Seed, 0, SegmentVPos, SegmentHPos, SocketIndex);
 
 			const FSegmentDecorationsData EmptyData;
-			TMap<FName, float> WeightsMap = UHouseEditorFunctionLibrary::GetNormalizedDecorationWeights(NewSegment, Socket->GetFName(), EmptyData);
-			
-			TSubclassOf<ABaseSegmentDecoration> DecorationClass;
-			TArray<FName> Names;
-			WeightsMap.GenerateKeyArray(Names);
-			
-			for (FName Name : Names)
-			{
-				Threshold += WeightsMap.FindRef(Name);
-				if (RValue <= Threshold)
-				{
-					DecorationClass = UHouseEditorFunctionLibrary::GetSegmentDecorationClassByFName(Name);
-					break;
-				}
-			}
+			TSubclassOf<ABaseSegmentDecoration> DecorationClass = UHouseEditorFunctionLibrary::PickDecorationClass(NewSegment, Socket->GetFName(), EmptyData, RValue);
 			if (DecorationClass != NULL)
 			{
-				ABaseSegmentDecoration* NewDecoration = GetWorld()->SpawnActor<ABaseSegmentDecoration>(DecorationClass, FVector(0.f), FRotator(0.f));
+				ABaseSegmentDecoration* NewDecoration = Cast<ABaseSegmentDecoration>(UHouseEditorFunctionLibrary::AcquireElement(GetWorld(), DecorationClass, this));
 				if (NewDecoration == NULL)
 				{
 					UE_LOG(LogTemp, Warning, TEXT("Decoration was not created!"));
 					return;
 				}
+				UHouseEditorFunctionLibrary::FinishElement(NewDecoration, FTransform());
 				NewDecoration->AttachToComponent(Socket, FAttachmentTransformRules::KeepRelativeTransform);
 			}
 		}
@@ -292,7 +282,7 @@ void APatternEditor::SavePattern()
 
 void APatternEditor::LoadPattern()
 {
-	FPatternData* Data;
+	const FPatternData* Data;
 	UDataTable* PatternsDataTable = UHouseEditorFunctionLibrary::GetPatternDataTable();
 
 	if (PatternsDataTable == NULL)
@@ -301,7 +291,7 @@ void APatternEditor::LoadPattern()
 		return;
 	}
 	
-	Data = PatternsDataTable->FindRow<FPatternData>(PatternName, FString());
+	Data = UHouseEditorFunctionLibrary::FindPattern(PatternName);
 	if (Data != NULL) {
 		SegmentsClassArray = Data->Lines;
 		bRepeatPattern = Data->bRepeatPattern;
@@ -3,62 +3,973 @@
 
 #include "RuntimeMesh/RMCProviderManager.h"
 #include "RuntimeMesh/EDGERuntimeMeshProvider.h"
+#include "RuntimeMesh.h"
+#include "RuntimeMeshComponent.h"
 
-TMap<FName, UEDGERuntimeMeshProvider*> EDGERuntimeProviderManager::Providers = TMap<FName, UEDGERuntimeMeshProvider*>();
+#include "Async/Async.h"
+#include "Components/HierarchicalInstancedStaticMeshComponent.h"
+#include "Engine/World.h"
+#include "RuntimeMesh/EDGEMeshUtility.h"
+#include "HAL/FileManager.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/QueuedThreadPool.h"
+#include "Misc/CoreDelegates.h"
+#include "Misc/DelayedAutoRegister.h"
+#include "Misc/EngineVersion.h"
+#include "Misc/FileHelper.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
+#include "UObject/GCObject.h"
+
+DECLARE_STATS_GROUP(TEXT("EDGE Provider Cache"), STATGROUP_EDGEProviderCache, STATCAT_Advanced);
+
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Memory Hits"), STAT_EDGEProviderCache_MemoryHits, STATGROUP_EDGEProviderCache);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Prefetch Hits"), STAT_EDGEProviderCache_PrefetchHits, STATGROUP_EDGEProviderCache);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Disk Hits"), STAT_EDGEProviderCache_DiskHits, STATGROUP_EDGEProviderCache);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Misses"), STAT_EDGEProviderCache_Misses, STATGROUP_EDGEProviderCache);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Generations"), STAT_EDGEProviderCache_Generations, STATGROUP_EDGEProviderCache);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Evictions"), STAT_EDGEProviderCache_Evictions, STATGROUP_EDGEProviderCache);
+DECLARE_MEMORY_STAT(TEXT("Bytes Read"), STAT_EDGEProviderCache_BytesRead, STATGROUP_EDGEProviderCache);
+DECLARE_MEMORY_STAT(TEXT("Cached Bytes"), STAT_EDGEProviderCache_CachedBytes, STATGROUP_EDGEProviderCache);
+DECLARE_FLOAT_ACCUMULATOR_STAT(TEXT("Decode Time (ms)"), STAT_EDGEProviderCache_DecodeTime, STATGROUP_EDGEProviderCache);
+DECLARE_FLOAT_ACCUMULATOR_STAT(TEXT("Generation Time (ms)"), STAT_EDGEProviderCache_GenerationTime, STATGROUP_EDGEProviderCache);
+DECLARE_CYCLE_STAT(TEXT("Decode"), STAT_EDGEProviderCache_Decode, STATGROUP_EDGEProviderCache);
+
+static TAutoConsoleVariable<int32> CVarProviderCacheBudgetMB(
+	TEXT("EDGE.ProviderCache.BudgetMB"),
+	256,
+	TEXT("Memory budget of cached house mesh data, in MB. Least recently used entries that are not bound to any house are evicted above it."));
+
+static TAutoConsoleVariable<int32> CVarProviderCacheMaxConcurrentLoads(
+	TEXT("EDGE.ProviderCache.MaxConcurrentLoads"),
+	4,
+	TEXT("How many house mesh data files are read in the background at the same time during prefetch."));
+
+static TAutoConsoleVariable<int32> CVarProviderCacheShareMeshes(
+	TEXT("EDGE.ProviderCache.ShareMeshes"),
+	1,
+	TEXT("If on, houses showing the same cached mesh data share one runtime mesh, so its render buffers and collision are created once."));
+
+static TAutoConsoleVariable<int32> CVarProviderCacheInstancingThreshold(
+	TEXT("EDGE.ProviderCache.InstancingThreshold"),
+	16,
+	TEXT("Templates shown by more houses than this in a game world are drawn as instances of one runtime built static mesh. 0 disables it."));
+
+static FAutoConsoleCommand CmdDumpProviderCache(
+	TEXT("EDGE.ProviderCache.Dump"),
+	TEXT("Prints hit/miss counters and timings of house mesh data cache per template."),
+	FConsoleCommandDelegate::CreateStatic(&EDGERuntimeProviderManager::DumpStats));
+
+static FAutoConsoleCommand CmdResetProviderCacheStats(
+	TEXT("EDGE.ProviderCache.ResetStats"),
+	TEXT("Clears counters printed by EDGE.ProviderCache.Dump."),
+	FConsoleCommandDelegate::CreateStatic(&EDGERuntimeProviderManager::ResetStats));
+
+FRWLock EDGERuntimeProviderManager::CacheLock;
+TMap<FObjectKey, EDGERuntimeProviderManager::FWorldCache> EDGERuntimeProviderManager::Caches;
+int64 EDGERuntimeProviderManager::TotalBytes = 0;
+volatile int64 EDGERuntimeProviderManager::AccessCounter = 0;
+TMap<FName, EDGERuntimeProviderManager::FPrefetchRequest> EDGERuntimeProviderManager::PrefetchRequests;
+TArray<FName> EDGERuntimeProviderManager::PrefetchQueue;
+int32 EDGERuntimeProviderManager::LoadsInFlight = 0;
+TMap<FObjectKey, TMap<FName, EDGERuntimeProviderManager::FSharedMesh>> EDGERuntimeProviderManager::SharedMeshes;
+TMap<FObjectKey, EDGERuntimeProviderManager::FWorldInstancing> EDGERuntimeProviderManager::Instancing;
+
+namespace
+{
+	// Keeps materials of cached snapshots alive. Snapshots are plain structs, so GC can't see them by itself.
+	class FEDGEProviderCacheReferencer : public FGCObject
+	{
+	public:
+		virtual void AddReferencedObjects(FReferenceCollector& Collector) override
+		{
+			EDGERuntimeProviderManager::AddReferencedObjects(Collector);
+		}
+
+		virtual FString GetReferencerName() const override
+		{
+			return TEXT("EDGERuntimeProviderManager");
+		}
+	};
+
+	// Power of two buckets in milliseconds, the last one takes everything above
+	struct FTimeHistogram
+	{
+		static const int32 NumBuckets = 12;
+		int32 Buckets[NumBuckets] = {};
+
+		void Add(double Seconds)
+		{
+			const double Milliseconds = Seconds * 1000.0;
+			int32 Bucket = 0;
+			while (Bucket < NumBuckets - 1 && Milliseconds >= static_cast<double>(1 << Bucket))
+			{
+				Bucket++;
+			}
+			Buckets[Bucket]++;
+		}
+
+		FString ToString() const
+		{
+			FString Result;
+			for (int32 Bucket = 0; Bucket < NumBuckets; Bucket++)
+			{
+				if (Buckets[Bucket] > 0)
+				{
+					Result += Bucket < NumBuckets - 1
+						? FString::Printf(TEXT(" <%dms:%d"), 1 << Bucket, Buckets[Bucket])
+						: FString::Printf(TEXT(" >=%dms:%d"), 1 << (Bucket - 1), Buckets[Bucket]);
+				}
+			}
+			return Result.IsEmpty() ? FString(TEXT(" -")) : Result;
+		}
+	};
+
+	struct FProviderKeyStats
+	{
+		int32 MemoryHits = 0;
+		int32 PrefetchHits = 0;
+		int32 DiskHits = 0;
+		int32 Misses = 0;
+		int32 Generations = 0;
+		int32 Evictions = 0;
+		int64 BytesRead = 0;
+		double DecodeSeconds = 0.0;
+		double GenerationSeconds = 0.0;
+	};
+
+	// Lookups happen on any thread, so per key data has its own lock. Always taken after CacheLock, never before
+	FCriticalSection StatsLock;
+	TMap<FName, FProviderKeyStats> KeyStats;
+	FTimeHistogram DecodeHistogram;
+	FTimeHistogram GenerationHistogram;
+
+	template<typename FunctorType>
+	void UpdateKeyStats(const FName Name, FunctorType&& Update)
+	{
+		FScopeLock Lock(&StatsLock);
+		Update(KeyStats.FindOrAdd(Name));
+	}
+
+	// Timing only - outcome of a lookup is counted once, where the house gets its data
+	void RecordDecode(const FName Name, double Seconds)
+	{
+		INC_FLOAT_STAT_BY(STAT_EDGEProviderCache_DecodeTime, Seconds * 1000.0);
+
+		FScopeLock Lock(&StatsLock);
+		KeyStats.FindOrAdd(Name).DecodeSeconds += Seconds;
+		DecodeHistogram.Add(Seconds);
+	}
+
+	void RecordPrefetchHit(const FName Name)
+	{
+		INC_DWORD_STAT(STAT_EDGEProviderCache_PrefetchHits);
+		UpdateKeyStats(Name, [](FProviderKeyStats& Stats) { Stats.PrefetchHits++; });
+	}
+
+	void RecordMiss(const FName Name)
+	{
+		INC_DWORD_STAT(STAT_EDGEProviderCache_Misses);
+		UpdateKeyStats(Name, [](FProviderKeyStats& Stats) { Stats.Misses++; });
+	}
+
+	// Bump when layout of collision files changes. Physics format and engine version are checked separately
+	static const int32 CollisionFileVersion = 2;
+	static const uint32 CollisionFileMagic = 0x43474445;		// "EDGC"
+
+	// File part of decoding, safe on worker threads
+	bool ReadRawMeshData(const FName Name, vector<EDGEMeshSectionData>& OutRawData, TArray<FBox>& OutCollisionBoxes)
+	{
+		SCOPE_CYCLE_COUNTER(STAT_EDGEProviderCache_Decode);
+
+		if (!UEDGEMeshUtility::ReadRawMeshDataFromFile(Name.ToString(), OutRawData, OutCollisionBoxes))
+		{
+			return false;
+		}
+
+		const int64 FileBytes = FMath::Max<int64>(IFileManager::Get().FileSize(*UEDGEMeshUtility::GetMeshDataFilePath(Name.ToString())), 0);
+		INC_MEMORY_STAT_BY(STAT_EDGEProviderCache_BytesRead, FileBytes);
+		UpdateKeyStats(Name, [FileBytes](FProviderKeyStats& Stats) { Stats.BytesRead += FileBytes; });
+		return true;
+	}
+}
+
+// Runs once the module is loaded, so no lookup ever initializes from a worker thread
+static FDelayedAutoRegisterHelper InitializeProviderManager(EDelayedRegisterRunPhase::ObjectSystemReady, []
+{
+	EDGERuntimeProviderManager::EnsureInitialized();
+});
+
+// Thread-safe: FindSnapshot, AddSnapshot, EvictToBudget and cooked collision lookups (CacheLock / StatsLock).
+// Game thread only: GetProvider, AddProvider, LoadSnapshot (materials are resolved from data table), prefetch, shared meshes and instancing.
+void EDGERuntimeProviderManager::EnsureInitialized()
+{
+	// Magic static - a concurrent first call waits until the delegates are bound
+	static const bool bInitialized = []()
+	{
+		static FEDGEProviderCacheReferencer Referencer;
+
+		// Editor worlds and PIE must not share or leak entries between each other
+		FWorldDelegates::OnWorldCleanup.AddStatic(&EDGERuntimeProviderManager::OnWorldCleanup);
+		FCoreDelegates::GetMemoryTrimDelegate().AddStatic(&EDGERuntimeProviderManager::TrimCache);
+
+		// Cooked collision is stored with house mesh data, so houses don't cook it again on every load
+		URuntimeMesh::FindPrecookedCollision.BindStatic(&EDGERuntimeProviderManager::FindCookedCollision);
+		URuntimeMesh::OnCollisionCooked.AddStatic(&EDGERuntimeProviderManager::StoreCookedCollision);
+		return true;
+	}();
+}
 
 bool EDGERuntimeProviderManager::GetProvider(UObject* Context, const FString& FileName, UEDGERuntimeMeshProvider*& OutProvider)
 {
+	check(IsInGameThread());
+	EnsureInitialized();
+
+	const FName Name = *FString::Printf(TEXT("%s"), *FileName);
+	const FObjectKey WorldKey(Context->GetWorld());
+
+	FEDGEMeshSnapshotPtr Snapshot = FindSnapshot(WorldKey, Name);
+	if (Snapshot.IsValid())
+	{
+		UE_LOG(LogTemp, Verbose, TEXT("~~ Provider <%s> found in memory."), *FileName);
+		INC_DWORD_STAT(STAT_EDGEProviderCache_MemoryHits);
+		UpdateKeyStats(Name, [](FProviderKeyStats& Stats) { Stats.MemoryHits++; });
+		OutProvider->SetTemplateName(Name);
+		OutProvider->SetSnapshot(Snapshot);
+		return true;
+	}
+
+	// Data may have been read in background already
+	Snapshot = ClaimPrefetched(Name);
+	if (Snapshot.IsValid())
+	{
+		UE_LOG(LogTemp, Verbose, TEXT("~~ Provider <%s> found in prefetched data."), *FileName);
+		RecordPrefetchHit(Name);
+		OutProvider->SetTemplateName(Name);
+		OutProvider->SetSnapshot(Snapshot);
+		AddSnapshot(WorldKey, Name, Snapshot);
+		return true;
+	}
+
+	// Try to read file
+	Snapshot = LoadSnapshot(FileName);
+	if (Snapshot.IsValid())
+	{
+		UE_LOG(LogTemp, Verbose, TEXT("~~ Provider <%s> found in file."), *FileName);
+		INC_DWORD_STAT(STAT_EDGEProviderCache_DiskHits);
+		UpdateKeyStats(Name, [](FProviderKeyStats& Stats) { Stats.DiskHits++; });
+		OutProvider->SetTemplateName(Name);
+		OutProvider->SetSnapshot(Snapshot);
+		AddSnapshot(WorldKey, Name, Snapshot);
+		return true;
+	}
+
+	UE_LOG(LogTemp, Verbose, TEXT("~~ Provider <%s> not found."), *FileName);
+	RecordMiss(Name);
+	return false;
+}
+
+void EDGERuntimeProviderManager::AddProvider(UObject* Context, const FName Name, UEDGERuntimeMeshProvider* Provider)
+{
+	check(IsInGameThread());
+	EnsureInitialized();
+
+	// Snapshot is immutable, so the cache shares it with the provider instead of copying
+	AddSnapshot(FObjectKey(Context->GetWorld()), Name, Provider->GetSnapshot());
+}
+
+FEDGEMeshSnapshotPtr EDGERuntimeProviderManager::LoadSnapshot(const FString& FileName)
+{
+	const FName Name = *FString::Printf(TEXT("%s"), *FileName);
+	const double StartTime = FPlatformTime::Seconds();
+
+	vector<EDGEMeshSectionData> RawData;
+	TArray<FBox> CollisionBoxes;
+	if (!ReadRawMeshData(Name, RawData, CollisionBoxes))
+	{
+		return nullptr;
+	}
+	FEDGEMeshSnapshotPtr Snapshot = MakeSnapshot(RawData, MoveTemp(CollisionBoxes));
+
+	RecordDecode(Name, FPlatformTime::Seconds() - StartTime);
+	return Snapshot;
+}
+
+// Materials are resolved from data table here, so it must run on game thread
+FEDGEMeshSnapshotPtr EDGERuntimeProviderManager::MakeSnapshot(const vector<EDGEMeshSectionData>& RawData, TArray<FBox> CollisionBoxes)
+{
+	SCOPE_CYCLE_COUNTER(STAT_EDGEProviderCache_Decode);
+
+	TSharedRef<FEDGEMeshSnapshot, ESPMode::ThreadSafe> Snapshot = MakeShared<FEDGEMeshSnapshot, ESPMode::ThreadSafe>();
+	UEDGEMeshUtility::ConvertSectionDataToUnreal(RawData, Snapshot->Sections, Snapshot->Materials);
+	Snapshot->CollisionBoxes = MoveTemp(CollisionBoxes);
+	UEDGERuntimeMeshProvider::CalculateBoundsPoints(Snapshot.Get());
+	return Snapshot;
+}
+
+// Requests remember the worlds of their houses, so cleanup of some other (preview, thumbnail) world doesn't drop them.
+// Outer world is used, as GetWorld() is not set yet while a level is being loaded.
+void EDGERuntimeProviderManager::Prefetch(const UObject* Context, const TArray<FString>& FileNames)
+{
+	check(IsInGameThread());
+	if (!FPlatformProcess::SupportsMultithreading())
+	{
+		// Houses will read their files on construction as before
+		return;
+	}
+	EnsureInitialized();
+
+	const FObjectKey OwnerKey(Context->GetTypedOuter<UWorld>());
+	for (const FString& FileName : FileNames)
+	{
+		const FName Name = *FString::Printf(TEXT("%s"), *FileName);
+		if (!PrefetchRequests.Contains(Name))
+		{
+			PrefetchQueue.Add(Name);
+		}
+		PrefetchRequests.FindOrAdd(Name).Worlds.Add(OwnerKey);
+	}
+	StartQueuedLoads();
+}
+
+bool EDGERuntimeProviderManager::RequestSnapshot(UObject* Context, const FString& FileName, FOnSnapshotLoaded OnLoaded)
+{
+	check(IsInGameThread());
+
 	const FName Name = *FString::Printf(TEXT("%s"), *FileName);
-	UEDGERuntimeMeshProvider** Ref = Providers.Find(Name);
-	UEDGERuntimeMeshProvider* Item = nullptr;
-	bool bCreateNew = true;
-	if (Ref != nullptr)
+	FPrefetchRequest* Request = PrefetchRequests.Find(Name);
+	if (Request == nullptr || Request->bLoaded)
+	{
+		// Nothing to wait for - GetProvider picks up loaded data synchronously
+		return false;
+	}
+
+	// Callbacks of a world are dropped on its cleanup, so nothing is added to the cache of a dead world
+	const FObjectKey WorldKey(Context->GetWorld());
+	const FObjectKey OwnerKey(Context->GetTypedOuter<UWorld>());
+	Request->Worlds.Add(OwnerKey);
+	Request->Callbacks.Emplace(OwnerKey, [WorldKey, Name, OnLoaded](FEDGEMeshSnapshotPtr Snapshot)
+	{
+		// Missing file is counted as miss by the lookup that follows
+		if (Snapshot.IsValid())
+		{
+			RecordPrefetchHit(Name);
+		}
+		AddSnapshot(WorldKey, Name, Snapshot);
+		OnLoaded(Snapshot);
+	});
+	return true;
+}
+
+void EDGERuntimeProviderManager::StartQueuedLoads()
+{
+	const int32 MaxLoads = FMath::Max(CVarProviderCacheMaxConcurrentLoads.GetValueOnGameThread(), 1);
+	FQueuedThreadPool* Pool = GIOThreadPool != nullptr ? GIOThreadPool : GThreadPool;
+
+	while (LoadsInFlight < MaxLoads && PrefetchQueue.Num() > 0)
 	{
-		Item = *Ref;
-		if (Item->IsValidLowLevel())
+		const FName Name = PrefetchQueue[0];
+		PrefetchQueue.RemoveAt(0, 1, false);
+		LoadsInFlight++;
+
+		// Only file reading and parsing happen on worker, snapshot is built back on game thread
+		AsyncPool(*Pool, [Name]()
 		{
-			if (Item->GetTemplateName() == Name)
+			const double StartTime = FPlatformTime::Seconds();
+			vector<EDGEMeshSectionData> RawData;
+			TArray<FBox> CollisionBoxes;
+			const bool bRead = ReadRawMeshData(Name, RawData, CollisionBoxes);
+			const double ReadSeconds = FPlatformTime::Seconds() - StartTime;
+			AsyncTask(ENamedThreads::GameThread, [Name, bRead, ReadSeconds, RawData = MoveTemp(RawData), CollisionBoxes = MoveTemp(CollisionBoxes)]()
 			{
-				bCreateNew = false;
+				OnPrefetchLoaded(Name, bRead ? &RawData : nullptr, CollisionBoxes, ReadSeconds);
+			});
+		});
+	}
+}
+
+void EDGERuntimeProviderManager::OnPrefetchLoaded(const FName Name, const vector<EDGEMeshSectionData>* RawData, const TArray<FBox>& CollisionBoxes, double ReadSeconds)
+{
+	LoadsInFlight--;
+
+	FPrefetchRequest* Request = PrefetchRequests.Find(Name);
+	if (Request != nullptr)
+	{
+		// Missing file is not counted here - GetProvider reports the miss when a house looks it up
+		FEDGEMeshSnapshotPtr Snapshot;
+		if (RawData != nullptr)
+		{
+			const double StartTime = FPlatformTime::Seconds();
+			Snapshot = MakeSnapshot(*RawData, CollisionBoxes);
+			RecordDecode(Name, ReadSeconds + FPlatformTime::Seconds() - StartTime);
+		}
+
+		// Waiting houses take the data right away, otherwise it is kept until some house asks for it
+		TArray<TPair<FObjectKey, FOnSnapshotLoaded>> Callbacks = MoveTemp(Request->Callbacks);
+		if (Callbacks.Num() > 0 || Request->Worlds.Num() == 0)
+		{
+			PrefetchRequests.Remove(Name);
+		}
+		else
+		{
+			Request->bLoaded = true;
+			Request->Snapshot = Snapshot;
+		}
+
+		for (const TPair<FObjectKey, FOnSnapshotLoaded>& Callback : Callbacks)
+		{
+			Callback.Value(Snapshot);
+		}
+	}
+
+	StartQueuedLoads();
+}
+
+FEDGEMeshSnapshotPtr EDGERuntimeProviderManager::ClaimPrefetched(const FName Name)
+{
+	if (!IsInGameThread())
+	{
+		return nullptr;
+	}
+
+	FPrefetchRequest* Request = PrefetchRequests.Find(Name);
+	if (Request == nullptr || !Request->bLoaded)
+	{
+		return nullptr;
+	}
+
+	FEDGEMeshSnapshotPtr Snapshot = Request->Snapshot;
+	PrefetchRequests.Remove(Name);
+	return Snapshot;
+}
+
+// Only data and callbacks of the given world go, null drops loaded data of every world. Loads in flight are removed once they finish.
+void EDGERuntimeProviderManager::DropUnclaimedPrefetches(const UWorld* World)
+{
+	const FObjectKey WorldKey(World);
+	for (auto It = PrefetchRequests.CreateIterator(); It; ++It)
+	{
+		FPrefetchRequest& Request = It.Value();
+		if (World != nullptr)
+		{
+			Request.Worlds.Remove(WorldKey);
+			Request.Callbacks.RemoveAll([&WorldKey](const TPair<FObjectKey, FOnSnapshotLoaded>& Callback) { return Callback.Key == WorldKey; });
+		}
+		if (Request.bLoaded && (World == nullptr || Request.Worlds.Num() == 0))
+		{
+			It.RemoveCurrent();
+		}
+	}
+}
+
+FEDGEMeshSnapshotPtr EDGERuntimeProviderManager::FindSnapshot(const FObjectKey& WorldKey, const FName Name)
+{
+	FReadScopeLock Lock(CacheLock);
+
+	FWorldCache* WorldCache = Caches.Find(WorldKey);
+	if (WorldCache == nullptr)
+	{
+		return nullptr;
+	}
+	FCacheEntry* Entry = WorldCache->Entries.Find(Name);
+	if (Entry == nullptr)
+	{
+		return nullptr;
+	}
+
+	// Only the access stamp changes under read lock, so it is updated atomically
+	FPlatformAtomics::InterlockedExchange(&Entry->LastAccess, FPlatformAtomics::InterlockedIncrement(&AccessCounter));
+	return Entry->Snapshot;
+}
+
+int64 EDGERuntimeProviderManager::GetCachedBytes(const FName Name)
+{
+	FReadScopeLock Lock(CacheLock);
+
+	int64 Bytes = 0;
+	for (const auto& WorldPair : Caches)
+	{
+		if (const FCacheEntry* Entry = WorldPair.Value.Entries.Find(Name))
+		{
+			Bytes += Entry->Bytes;
+		}
+	}
+	return Bytes;
+}
+
+void EDGERuntimeProviderManager::AddSnapshot(const FObjectKey& WorldKey, const FName Name, FEDGEMeshSnapshotPtr Snapshot)
+{
+	if (!Snapshot.IsValid())
+	{
+		return;
+	}
+
+	{
+		FWriteScopeLock Lock(CacheLock);
+
+		FWorldCache& WorldCache = Caches.FindOrAdd(WorldKey);
+		FCacheEntry& Entry = WorldCache.Entries.FindOrAdd(Name);
+		TotalBytes -= Entry.Bytes;
+		WorldCache.Bytes -= Entry.Bytes;
+
+		Entry.Snapshot = MoveTemp(Snapshot);
+		Entry.Bytes = Entry.Snapshot->GetAllocatedBytes();
+		Entry.LastAccess = FPlatformAtomics::InterlockedIncrement(&AccessCounter);
+
+		TotalBytes += Entry.Bytes;
+		WorldCache.Bytes += Entry.Bytes;
+		SET_MEMORY_STAT(STAT_EDGEProviderCache_CachedBytes, TotalBytes);
+	}
+
+	EvictToBudget(static_cast<int64>(CVarProviderCacheBudgetMB.GetValueOnAnyThread()) * 1024 * 1024);
+}
+
+void EDGERuntimeProviderManager::EvictToBudget(int64 BudgetBytes)
+{
+	FWriteScopeLock Lock(CacheLock);
+
+	if (TotalBytes <= BudgetBytes)
+	{
+		return;
+	}
+
+	// Only cold entries are evicted - if some house still holds the snapshot, removing it would free nothing
+	struct FCandidate
+	{
+		FObjectKey WorldKey;
+		FName Name;
+		int64 LastAccess;
+	};
+	TArray<FCandidate> Candidates;
+	for (const auto& WorldPair : Caches)
+	{
+		for (const auto& EntryPair : WorldPair.Value.Entries)
+		{
+			if (EntryPair.Value.Snapshot.IsUnique())
+			{
+				Candidates.Add({ WorldPair.Key, EntryPair.Key, EntryPair.Value.LastAccess });
 			}
 		}
 	}
-	
-	if (bCreateNew)
+	Candidates.Sort([](const FCandidate& A, const FCandidate& B) { return A.LastAccess < B.LastAccess; });
+
+	for (const FCandidate& Candidate : Candidates)
 	{
-		TArray<FRMCSectionData> AllSections;
-		TArray<UMaterialInterface*> AllMaterials;
-		// Try to read file
-		if (UEDGEMeshUtility::ReadMeshDataFromFile(FileName, AllSections, AllMaterials))
+		if (TotalBytes <= BudgetBytes)
 		{
-			UE_LOG(LogTemp, Display, TEXT("~~ Provider <%s> found in file."), *FileName);
-			OutProvider->SetTemplateName(Name);
-			OutProvider->SetSectionsData(AllSections);
-			OutProvider->SetMaterials(AllMaterials);
-			AddProvider(Context, Name, OutProvider);
-			return true;
+			break;
 		}
-		UE_LOG(LogTemp, Display, TEXT("~~ Provider <%s> not found."), *FileName);
+		RemoveEntry_Unsynced(Candidate.WorldKey, Candidate.Name);
+		INC_DWORD_STAT(STAT_EDGEProviderCache_Evictions);
+		UpdateKeyStats(Candidate.Name, [](FProviderKeyStats& Stats) { Stats.Evictions++; });
+	}
+}
+
+void EDGERuntimeProviderManager::RemoveEntry_Unsynced(const FObjectKey& WorldKey, const FName Name)
+{
+	FWorldCache* WorldCache = Caches.Find(WorldKey);
+	if (WorldCache == nullptr)
+	{
+		return;
+	}
+
+	FCacheEntry Entry;
+	if (WorldCache->Entries.RemoveAndCopyValue(Name, Entry))
+	{
+		TotalBytes -= Entry.Bytes;
+		WorldCache->Bytes -= Entry.Bytes;
+		SET_MEMORY_STAT(STAT_EDGEProviderCache_CachedBytes, TotalBytes);
+	}
+	if (WorldCache->Entries.Num() == 0)
+	{
+		Caches.Remove(WorldKey);
+	}
+}
+
+URuntimeMesh* EDGERuntimeProviderManager::GetSharedMesh(const UObject* Context, const FName Name, UEDGERuntimeMeshProvider* Provider)
+{
+	check(IsInGameThread());
+
+	const FEDGEMeshSnapshotPtr Snapshot = Provider != nullptr ? Provider->GetSnapshot() : nullptr;
+	if (CVarProviderCacheShareMeshes.GetValueOnGameThread() == 0 || Context == nullptr || Context->GetWorld() == nullptr || !Snapshot.IsValid())
+	{
+		return nullptr;
+	}
+
+	// Mesh lives while any component links it; the entry only points to it
+	FSharedMesh& Shared = SharedMeshes.FindOrAdd(FObjectKey(Context->GetWorld())).FindOrAdd(Name);
+	if (Shared.Mesh.IsValid() && Shared.Snapshot.Pin() == Snapshot)
+	{
+		return Shared.Mesh.Get();
+	}
+
+	// Regenerated data gets a new mesh, houses still showing the old one keep it. Outer is the world so collision can be cooked async.
+	URuntimeMesh* Mesh = NewObject<URuntimeMesh>(Context->GetWorld(), NAME_None, RF_Transient);
+	Mesh->Initialize(Provider->CreateSharedCopy(Mesh));
+	Shared.Mesh = Mesh;
+	Shared.Snapshot = Snapshot;
+	return Mesh;
+}
+
+// Provider of the shared mesh of Name if Component is the only one showing it, so it may be patched in place like a mesh of its own
+UEDGERuntimeMeshProvider* EDGERuntimeProviderManager::GetExclusiveSharedProvider(const UObject* Context, const FName Name, URuntimeMeshComponent* Component)
+{
+	check(IsInGameThread());
+
+	const TMap<FName, FSharedMesh>* WorldShared = Context != nullptr && Context->GetWorld() != nullptr ? SharedMeshes.Find(FObjectKey(Context->GetWorld())) : nullptr;
+	const FSharedMesh* Shared = WorldShared != nullptr ? WorldShared->Find(Name) : nullptr;
+	URuntimeMesh* Mesh = Shared != nullptr ? Shared->Mesh.Get() : nullptr;
+	if (Mesh == nullptr || Component == nullptr || Component->GetRuntimeMesh() != Mesh)
+	{
+		return nullptr;
+	}
+
+	int32 NumUsers = 0;
+	Mesh->DoForAllLinkedComponents([&NumUsers](URuntimeMeshComponent* MeshComponent)
+	{
+		NumUsers++;
+	});
+	return NumUsers == 1 ? Cast<UEDGERuntimeMeshProvider>(Mesh->GetProviderPtr()) : nullptr;
+}
+
+// Entry follows the patched data, so houses loading Name from the cache later bind the same mesh
+void EDGERuntimeProviderManager::OnSharedMeshPatched(const UObject* Context, const FName Name, UEDGERuntimeMeshProvider* Provider)
+{
+	check(IsInGameThread());
+
+	TMap<FName, FSharedMesh>* WorldShared = Context != nullptr && Context->GetWorld() != nullptr ? SharedMeshes.Find(FObjectKey(Context->GetWorld())) : nullptr;
+	FSharedMesh* Shared = WorldShared != nullptr ? WorldShared->Find(Name) : nullptr;
+	if (Shared != nullptr && Shared->Mesh.IsValid() && Shared->Mesh->GetProviderPtr() == Provider)
+	{
+		Shared->Snapshot = Provider->GetSnapshot();
+	}
+}
+
+// Instance index of a house is its index in Houses, both are removed by swapping with the last one
+void EDGERuntimeProviderManager::AddTemplateInstance(UPrimitiveComponent* HouseMesh, const FName Name, UEDGERuntimeMeshProvider* Provider)
+{
+	check(IsInGameThread());
+
+	UWorld* World = HouseMesh != nullptr ? HouseMesh->GetWorld() : nullptr;
+	const int32 Threshold = CVarProviderCacheInstancingThreshold.GetValueOnGameThread();
+	if (Threshold <= 0 || World == nullptr || !World->IsGameWorld())
+	{
+		return;
+	}
+
+	FWorldInstancing& WorldInstancing = Instancing.FindOrAdd(FObjectKey(World));
+	FInstancedTemplate& Template = WorldInstancing.Templates.FindOrAdd(Name);
+	UHierarchicalInstancedStaticMeshComponent* Instances = Template.Component.Get();
+
+	if (Template.Houses.Contains(HouseMesh))
+	{
+		UpdateTemplateInstance(HouseMesh, Name);
+		return;
+	}
+
+	Template.Houses.Add(HouseMesh);
+	if (Instances != nullptr)
+	{
+		Instances->AddInstanceWorldSpace(HouseMesh->GetComponentTransform());
+		HideInstancedHouse(Template, HouseMesh);
+	}
+	else if (Template.Houses.Num() > Threshold)
+	{
+		PromoteTemplate(World, WorldInstancing, Template, Provider);
+	}
+}
+
+void EDGERuntimeProviderManager::RemoveTemplateInstance(UPrimitiveComponent* HouseMesh, const FName Name)
+{
+	check(IsInGameThread());
+
+	FWorldInstancing* WorldInstancing = HouseMesh != nullptr ? Instancing.Find(FObjectKey(HouseMesh->GetWorld())) : nullptr;
+	FInstancedTemplate* Template = WorldInstancing != nullptr ? WorldInstancing->Templates.Find(Name) : nullptr;
+	const int32 Index = Template != nullptr ? Template->Houses.IndexOfByKey(HouseMesh) : INDEX_NONE;
+	if (Index == INDEX_NONE)
+	{
+		return;
+	}
+
+	Template->Houses.RemoveAtSwap(Index);
+	if (Template->Component.IsValid())
+	{
+		Template->Component->RemoveInstance(Index);
+		ShowInstancedHouse(*Template, HouseMesh);
+	}
+}
+
+// Houses move in the editor and by gameplay, their instance follows
+void EDGERuntimeProviderManager::UpdateTemplateInstance(UPrimitiveComponent* HouseMesh, const FName Name)
+{
+	check(IsInGameThread());
+
+	FWorldInstancing* WorldInstancing = HouseMesh != nullptr ? Instancing.Find(FObjectKey(HouseMesh->GetWorld())) : nullptr;
+	FInstancedTemplate* Template = WorldInstancing != nullptr ? WorldInstancing->Templates.Find(Name) : nullptr;
+	const int32 Index = Template != nullptr ? Template->Houses.IndexOfByKey(HouseMesh) : INDEX_NONE;
+	if (Index != INDEX_NONE && Template->Component.IsValid())
+	{
+		Template->Component->UpdateInstanceTransform(Index, HouseMesh->GetComponentTransform(), true, true);
+	}
+}
+
+// Instances carry collision of the template, a hidden house keeping its own would collide twice
+void EDGERuntimeProviderManager::HideInstancedHouse(FInstancedTemplate& Template, UPrimitiveComponent* HouseMesh)
+{
+	Template.HiddenCollision.Add(HouseMesh, HouseMesh->GetCollisionEnabled());
+	HouseMesh->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+	HouseMesh->SetVisibility(false);
+}
+
+void EDGERuntimeProviderManager::ShowInstancedHouse(FInstancedTemplate& Template, UPrimitiveComponent* HouseMesh)
+{
+	TEnumAsByte<ECollisionEnabled::Type> CollisionEnabled = ECollisionEnabled::QueryAndPhysics;
+	Template.HiddenCollision.RemoveAndCopyValue(HouseMesh, CollisionEnabled);
+	HouseMesh->SetCollisionEnabled(CollisionEnabled);
+	HouseMesh->SetVisibility(true);
+}
+
+void EDGERuntimeProviderManager::PromoteTemplate(UWorld* World, FWorldInstancing& WorldInstancing, FInstancedTemplate& Template, UEDGERuntimeMeshProvider* Provider)
+{
+	Template.Houses.RemoveAllSwap([](const TWeakObjectPtr<UPrimitiveComponent>& House) { return !House.IsValid(); });
+	if (Template.Houses.Num() == 0)
+	{
+		return;
+	}
+
+	if (!WorldInstancing.Host.IsValid())
+	{
+		FActorSpawnParameters SpawnParams;
+		SpawnParams.ObjectFlags = RF_Transient;
+		WorldInstancing.Host = World->SpawnActor<AActor>(SpawnParams);
+	}
+	AActor* Host = WorldInstancing.Host.Get();
+
+	UStaticMesh* StaticMesh = Host != nullptr ? UEDGEMeshUtility::BuildStaticMesh(Host, Provider->GetSectionData(), Provider->GetMaterials(), Provider->GetLODScreenSizes(), Provider->GetCollisionBoxes()) : nullptr;
+	if (StaticMesh == nullptr)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("~~ Couldn't build static mesh of <%s>, its houses stay separate meshes."), *Provider->GetTemplateName().ToString());
+		return;
+	}
+
+	// Instances take over drawing and collision, with the collision settings of the houses
+	UHierarchicalInstancedStaticMeshComponent* Instances = NewObject<UHierarchicalInstancedStaticMeshComponent>(Host);
+	Instances->SetStaticMesh(StaticMesh);
+	Instances->SetCollisionProfileName(Template.Houses[0]->GetCollisionProfileName());
+	Instances->RegisterComponent();
+	Host->AddInstanceComponent(Instances);
+
+	for (const TWeakObjectPtr<UPrimitiveComponent>& House : Template.Houses)
+	{
+		Instances->AddInstanceWorldSpace(House->GetComponentTransform());
+		HideInstancedHouse(Template, House.Get());
+	}
+	Template.Component = Instances;
+
+	UE_LOG(LogTemp, Display, TEXT("~~ <%s> is drawn as %d instances."), *Provider->GetTemplateName().ToString(), Template.Houses.Num());
+}
+
+void EDGERuntimeProviderManager::TrimCache()
+{
+	UE_LOG(LogTemp, Display, TEXT("~~ Memory trim requested, dropping unused house mesh data."));
+	DropUnclaimedPrefetches(nullptr);
+	EvictToBudget(0);
+}
+
+void EDGERuntimeProviderManager::OnWorldCleanup(UWorld* World, bool bSessionEnded, bool bCleanupResources)
+{
+	// Prefetched data is not bound to a world yet, nobody is going to claim it after the level is gone
+	DropUnclaimedPrefetches(World);
+	SharedMeshes.Remove(FObjectKey(World));
+	Instancing.Remove(FObjectKey(World));
+
+	FWriteScopeLock Lock(CacheLock);
+
+	FWorldCache WorldCache;
+	if (Caches.RemoveAndCopyValue(FObjectKey(World), WorldCache))
+	{
+		TotalBytes -= WorldCache.Bytes;
+		SET_MEMORY_STAT(STAT_EDGEProviderCache_CachedBytes, TotalBytes);
+	}
+}
+
+void EDGERuntimeProviderManager::AddReferencedObjects(FReferenceCollector& Collector)
+{
+	for (const auto& RequestPair : PrefetchRequests)
+	{
+		if (RequestPair.Value.Snapshot.IsValid())
+		{
+			for (UMaterialInterface* Material : RequestPair.Value.Snapshot->Materials)
+			{
+				Collector.AddReferencedObject(Material);
+			}
+		}
+	}
+
+	FReadScopeLock Lock(CacheLock);
+
+	for (const auto& WorldPair : Caches)
+	{
+		for (const auto& EntryPair : WorldPair.Value.Entries)
+		{
+			for (UMaterialInterface* Material : EntryPair.Value.Snapshot->Materials)
+			{
+				Collector.AddReferencedObject(Material);
+			}
+		}
+	}
+}
+
+void EDGERuntimeProviderManager::ResetManager()
+{
+	// Queued and in-flight loads are kept, some houses may still wait for them
+	DropUnclaimedPrefetches(nullptr);
+	SharedMeshes.Empty();
+	Instancing.Empty();
+
+	FWriteScopeLock Lock(CacheLock);
+	Caches.Empty();
+	TotalBytes = 0;
+	SET_MEMORY_STAT(STAT_EDGEProviderCache_CachedBytes, TotalBytes);
+}
+
+// Read only when a mesh meets a collision hash no body setup has in memory, shared setups serve the rest - nothing is kept here
+bool EDGERuntimeProviderManager::FindCookedCollision(URuntimeMeshProvider* Provider, uint64 CollisionHash, TArray<uint8>& OutCookedData)
+{
+	UEDGERuntimeMeshProvider* EdgeProvider = Cast<UEDGERuntimeMeshProvider>(Provider);
+	if (EdgeProvider == nullptr || EdgeProvider->GetTemplateName().IsNone())
+	{
 		return false;
 	}
+	return ReadCookedCollision(EdgeProvider->GetTemplateName(), CollisionHash, OutCookedData);
+}
+
+void EDGERuntimeProviderManager::StoreCookedCollision(URuntimeMeshProvider* Provider, uint64 CollisionHash, const TArray<uint8>& CookedData)
+{
+	UEDGERuntimeMeshProvider* EdgeProvider = Cast<UEDGERuntimeMeshProvider>(Provider);
+	if (EdgeProvider == nullptr || EdgeProvider->GetTemplateName().IsNone() || CookedData.Num() == 0)
+	{
+		return;
+	}
+	const FString Name = EdgeProvider->GetTemplateName().ToString();
+	const FString FilePath = UEDGEMeshUtility::GetCollisionDataFilePath(Name, CollisionHash);
+	if (IFileManager::Get().FileExists(*FilePath))
+	{
+		return;
+	}
+
+	// Cooks of earlier content of this entry are never going to match again
+	UEDGEMeshUtility::RemoveCollisionDataFiles(Name);
+
+	TArray<uint8> FileData;
+	FMemoryWriter Writer(FileData);
+	uint32 Magic = CollisionFileMagic;
+	int32 Version = CollisionFileVersion;
+	FString PhysicsFormat = FPlatformProperties::GetPhysicsFormat().ToString();
+	FString EngineVersion = FEngineVersion::Current().ToString();
+	Writer << Magic << Version << PhysicsFormat << EngineVersion << CollisionHash;
+	Writer << const_cast<TArray<uint8>&>(CookedData);
 
-	UE_LOG(LogTemp, Display, TEXT("~~ Provider <%s> found in memory."), *FileName);
-	OutProvider->SetTemplateName(Item->GetTemplateName());
-	OutProvider->SetSectionsData(Item->GetSectionData());
-	OutProvider->SetMaterials(Item->GetMaterials());
+	if (!FFileHelper::SaveArrayToFile(FileData, *FilePath))
+	{
+		UE_LOG(LogTemp, Warning, TEXT("~~ Cant write cooked collision to %s."), *FilePath);
+	}
+}
+
+bool EDGERuntimeProviderManager::ReadCookedCollision(const FName Name, uint64 CollisionHash, TArray<uint8>& OutCookedData)
+{
+	TArray<uint8> FileData;
+	if (!FFileHelper::LoadFileToArray(FileData, *UEDGEMeshUtility::GetCollisionDataFilePath(Name.ToString(), CollisionHash), FILEREAD_Silent))
+	{
+		return false;
+	}
+	INC_MEMORY_STAT_BY(STAT_EDGEProviderCache_BytesRead, FileData.Num());
+
+	FMemoryReader Reader(FileData);
+	uint32 Magic = 0;
+	int32 Version = 0;
+	Reader << Magic << Version;
+	if (Magic != CollisionFileMagic || Version != CollisionFileVersion)
+	{
+		return false;
+	}
+
+	// Cooked data from another physics format or engine build can't be loaded - it is cooked again and overwritten
+	FString PhysicsFormat;
+	FString EngineVersion;
+	Reader << PhysicsFormat << EngineVersion;
+	if (PhysicsFormat != FPlatformProperties::GetPhysicsFormat().ToString() || EngineVersion != FEngineVersion::Current().ToString())
+	{
+		UE_LOG(LogTemp, Verbose, TEXT("~~ Cooked collision of <%s> is for %s (%s), ignoring."), *Name.ToString(), *PhysicsFormat, *EngineVersion);
+		return false;
+	}
+
+	uint64 FileHash = 0;
+	Reader << FileHash << OutCookedData;
+	if (Reader.IsError() || FileHash != CollisionHash || OutCookedData.Num() == 0)
+	{
+		OutCookedData.Empty();
+		return false;
+	}
 	return true;
 }
 
-void EDGERuntimeProviderManager::AddProvider(UObject* Context, const FName Name, UEDGERuntimeMeshProvider* Provider)
+void EDGERuntimeProviderManager::RecordGeneration(const FName Name, double Seconds)
 {
-	UEDGERuntimeMeshProvider* NewProvider = NewObject<UEDGERuntimeMeshProvider>(Context->GetWorld());
-	NewProvider->SetTemplateName(Provider->GetTemplateName());
-	NewProvider->SetSectionsData(Provider->GetSectionData());
-	NewProvider->SetMaterials(Provider->GetMaterials());
-	Providers.Add(Name, NewProvider);
+	INC_DWORD_STAT(STAT_EDGEProviderCache_Generations);
+	INC_FLOAT_STAT_BY(STAT_EDGEProviderCache_GenerationTime, Seconds * 1000.0);
+
+	FScopeLock Lock(&StatsLock);
+	FProviderKeyStats& Stats = KeyStats.FindOrAdd(Name);
+	Stats.Generations++;
+	Stats.GenerationSeconds += Seconds;
+	GenerationHistogram.Add(Seconds);
 }
 
-void EDGERuntimeProviderManager::ResetManager()
+void EDGERuntimeProviderManager::DumpStats()
+{
+	int64 CachedBytes = 0;
+	int32 CachedEntries = 0;
+	{
+		FReadScopeLock Lock(CacheLock);
+		CachedBytes = TotalBytes;
+		for (const auto& WorldPair : Caches)
+		{
+			CachedEntries += WorldPair.Value.Entries.Num();
+		}
+	}
+
+	FScopeLock Lock(&StatsLock);
+
+	// Keys that cost the most generation time go first - those are the ones to look at
+	TArray<FName> Names;
+	KeyStats.GetKeys(Names);
+	Names.Sort([](const FName& A, const FName& B)
+	{
+		const FProviderKeyStats& StatsA = KeyStats[A];
+		const FProviderKeyStats& StatsB = KeyStats[B];
+		return StatsA.GenerationSeconds + StatsA.DecodeSeconds > StatsB.GenerationSeconds + StatsB.DecodeSeconds;
+	});
+
+	UE_LOG(LogTemp, Display, TEXT("~~ Provider cache: %d entries, %.2f MB of %d MB budget, %d loads in flight, %d queued."),
+		CachedEntries, CachedBytes / (1024.0 * 1024.0), CVarProviderCacheBudgetMB.GetValueOnAnyThread(), LoadsInFlight, PrefetchQueue.Num());
+	UE_LOG(LogTemp, Display, TEXT("~~ %-40s %8s %8s %8s %8s %8s %8s %10s %10s %10s"),
+		TEXT("Key"), TEXT("Memory"), TEXT("Prefetch"), TEXT("Disk"), TEXT("Miss"), TEXT("Generate"), TEXT("Evict"), TEXT("Read KB"), TEXT("Decode ms"), TEXT("Gen ms"));
+	for (const FName& Name : Names)
+	{
+		const FProviderKeyStats& Stats = KeyStats[Name];
+		UE_LOG(LogTemp, Display, TEXT("~~ %-40s %8d %8d %8d %8d %8d %8d %10.1f %10.2f %10.2f"),
+			*Name.ToString(), Stats.MemoryHits, Stats.PrefetchHits, Stats.DiskHits, Stats.Misses, Stats.Generations, Stats.Evictions,
+			Stats.BytesRead / 1024.0, Stats.DecodeSeconds * 1000.0, Stats.GenerationSeconds * 1000.0);
+	}
+	UE_LOG(LogTemp, Display, TEXT("~~ Decode times:%s"), *DecodeHistogram.ToString());
+	UE_LOG(LogTemp, Display, TEXT("~~ Generation times:%s"), *GenerationHistogram.ToString());
+}
+
+void EDGERuntimeProviderManager::ResetStats()
 {
-	Providers.Empty();
+	FScopeLock Lock(&StatsLock);
+	KeyStats.Empty();
+	DecodeHistogram = FTimeHistogram();
+	GenerationHistogram = FTimeHistogram();
 }
@@ -5,11 +5,25 @@
 #include "PhysicsEngine/BodySetup.h"
 #include "PhysicsEngine/PhysicsSettings.h"
 #include "IPhysXCookingModule.h"
+#if WITH_PHYSX && PHYSICS_INTERFACE_PHYSX
+#include "PhysicsPublic.h"
+#include "PhysXCookHelper.h"
+#include "PhysXPublic.h"
+#endif
 #include "RuntimeMeshComponent.h"
 #include "RuntimeMeshProxy.h"
 #include "Providers/RuntimeMeshProviderStatic.h"
 #include "RuntimeMeshComponentEngineSubsystem.h"
+#include "Async/Async.h"
 #include "Async/AsyncWork.h"
+#include "Containers/Queue.h"
+#include "Containers/Ticker.h"
+#include "Camera/PlayerCameraManager.h"
+#include "Engine/World.h"
+#include "GameFramework/PlayerController.h"
+#include "HAL/IConsoleManager.h"
+#include "Hash/CityHash.h"
+#include "Misc/ScopeExit.h"
 #include "UObject/UObjectThreadContext.h"
 
 
@@ -21,28 +35,328 @@ DECLARE_CYCLE_STAT(TEXT("RuntimeMeshDelayedActions - Has Physics TriMesh"), STAT
 DECLARE_CYCLE_STAT(TEXT("RuntimeMeshDelayedActions - Update Collision"), STAT_RuntimeMesh_UpdateCollision, STATGROUP_RuntimeMesh);
 DECLARE_CYCLE_STAT(TEXT("RuntimeMeshDelayedActions - Finish Collision Async Cook"), STAT_RuntimeMesh_FinishCollisionAsyncCook, STATGROUP_RuntimeMesh);
 DECLARE_CYCLE_STAT(TEXT("RuntimeMeshDelayedActions - Finalize Collision Cooked Data"), STAT_RuntimeMesh_FinalizeCollisionCookedData, STATGROUP_RuntimeMesh);
+DECLARE_DWORD_COUNTER_STAT(TEXT("RuntimeMeshUpdateDispatch - Meshes"), STAT_RuntimeMeshUpdateDispatch_Meshes, STATGROUP_RuntimeMesh);
+DECLARE_DWORD_COUNTER_STAT(TEXT("RuntimeMeshUpdateDispatch - Tasks"), STAT_RuntimeMeshUpdateDispatch_Tasks, STATGROUP_RuntimeMesh);
+DECLARE_DWORD_COUNTER_STAT(TEXT("RuntimeMeshUpdateDispatch - Budget Exceeded"), STAT_RuntimeMeshUpdateDispatch_BudgetExceeded, STATGROUP_RuntimeMesh);
+DECLARE_DWORD_COUNTER_STAT(TEXT("RuntimeMeshUpdateDispatch - Deferred Collisions"), STAT_RuntimeMeshUpdateDispatch_DeferredCollisions, STATGROUP_RuntimeMesh);
+DECLARE_CYCLE_STAT(TEXT("RuntimeMeshUpdateDispatch - Tick"), STAT_RuntimeMeshUpdateDispatch_Tick, STATGROUP_RuntimeMesh);
+DECLARE_DWORD_COUNTER_STAT(TEXT("RuntimeMeshSharedCollision - Shared Body Setups Reused"), STAT_RuntimeMeshSharedCollision_Reused, STATGROUP_RuntimeMesh);
+DECLARE_DWORD_COUNTER_STAT(TEXT("RuntimeMeshSharedCollision - Unchanged Updates Skipped"), STAT_RuntimeMeshSharedCollision_Skipped, STATGROUP_RuntimeMesh);
+DECLARE_DWORD_COUNTER_STAT(TEXT("RuntimeMeshSharedCollision - Precooked Data Loaded"), STAT_RuntimeMeshSharedCollision_Precooked, STATGROUP_RuntimeMesh);
+DECLARE_MEMORY_STAT(TEXT("RuntimeMeshMemory - Render Data"), STAT_RuntimeMeshMemory_RenderData, STATGROUP_RuntimeMesh);
+DECLARE_MEMORY_STAT(TEXT("RuntimeMeshMemory - Body Setups"), STAT_RuntimeMeshMemory_BodySetups, STATGROUP_RuntimeMesh);
+
+static TAutoConsoleVariable<int32> CVarRuntimeMeshUpdateTasks(
+	TEXT("RuntimeMesh.UpdateTasksPerFrame"),
+	4,
+	TEXT("Max number of background tasks the queued mesh updates of one frame are split between."));
+
+static TAutoConsoleVariable<float> CVarRuntimeMeshUpdateBudgetMs(
+	TEXT("RuntimeMesh.UpdateBudgetMs"),
+	8.f,
+	TEXT("Per frame budget for meshes that are not visible: game thread time of collision updates, and wall time after dispatch in which background mesh updates may start. Visible meshes ignore it."));
+
+static TAutoConsoleVariable<float> CVarRuntimeMeshVisibleDistance(
+	TEXT("RuntimeMesh.VisibleDistance"),
+	10000.f,
+	TEXT("Meshes not rendered lately still count as visible within this distance of a view, or when in front of the player camera. Covers the first frames after load."));
 
 
 #define RMC_LOG_VERBOSE(Format, ...) \
 	UE_LOG(RuntimeMeshLog, Verbose, TEXT("[RM:%d Thread:%d]: " Format), GetMeshId(), FPlatformTLS::GetCurrentThreadId(), ##__VA_ARGS__);
 
 
+// Size of the buffers the proxy creates from this data
+static int64 GetRenderableMeshBytes(const FRuntimeMeshRenderableMeshData& MeshData)
+{
+	return static_cast<int64>(MeshData.Positions.Num()) * MeshData.Positions.GetStride()
+		+ static_cast<int64>(MeshData.Tangents.Num()) * MeshData.Tangents.GetStride()
+		+ static_cast<int64>(MeshData.TexCoords.Num()) * MeshData.TexCoords.GetStride()
+		+ static_cast<int64>(MeshData.Colors.Num()) * MeshData.Colors.GetStride()
+		+ static_cast<int64>(MeshData.Triangles.Num()) * MeshData.Triangles.GetStride()
+		+ static_cast<int64>(MeshData.AdjacencyTriangles.Num()) * MeshData.AdjacencyTriangles.GetStride();
+}
+
+
+
+
+struct FRuntimeMeshUpdateRequest
+{
+	FRuntimeMeshWeakRef Mesh;
+	float Priority;
+	bool bIsVisible;
+};
+
+class FRuntimeMeshBatchUpdateTask : public FNonAbandonableTask
+{
+	friend class FAutoDeleteAsyncTask<FRuntimeMeshBatchUpdateTask>;
+
+	TArray<FRuntimeMeshUpdateRequest> Requests;
+	int64 Frame;
+
+	FRuntimeMeshBatchUpdateTask(TArray<FRuntimeMeshUpdateRequest>&& InRequests, int64 InFrame)
+		: Requests(MoveTemp(InRequests))
+		, Frame(InFrame)
+	{
+	}
+
+	void DoWork();
 
+	FORCEINLINE TStatId GetStatId() const
+	{
+		return TStatId();
+		// RETURN_QUICK_DECLARE_CYCLE_STAT(ExampleAsyncTask, STATGROUP_ThreadPoolAsyncTasks);
+	}
+};
 
-class FRuntimeMeshUpdateTask : public FNonAbandonableTask
+/*
+*	Collects meshes with thread safe providers that need a mesh update, and once per frame splits
+*	them between a few background tasks instead of starting a task per mesh.
+*	Visible meshes go first, then the ones with higher priority given by the game. Mesh and collision
+*	updates have a per frame time budget, whatever doesn't fit waits for next frame - except visible meshes.
+*/
+class FRuntimeMeshUpdateDispatcher
 {
-	friend class FAutoDeleteAsyncTask<FRuntimeMeshUpdateTask>;
+public:
+	static FRuntimeMeshUpdateDispatcher& Get()
+	{
+		static FRuntimeMeshUpdateDispatcher Dispatcher;
+		return Dispatcher;
+	}
+
+	// Can be called from any thread, each mesh is expected to be queued once until it's handled
+	void Enqueue(const FRuntimeMeshWeakRef& Mesh)
+	{
+		PendingMeshes.Enqueue(Mesh);
+		EnsureTickerRegistered();
+	}
+
+	// Worker side of the budget: updates may start within the budget after their frame's dispatch, measured in wall time,
+	// as tasks run in parallel. Batches still running once the next frame is dispatched hand the rest over to it.
+	bool CanStartMeshUpdate(const FRuntimeMeshUpdateRequest& Request, int64 BatchFrame) const
+	{
+		if (Request.bIsVisible)
+		{
+			return true;
+		}
+		return BatchFrame == DispatchFrame.GetValue() && static_cast<int64>(FPlatformTime::Cycles64()) - DispatchStartCycles.GetValue() < GetBudgetCycles();
+	}
+
+	int64 GetDispatchFrame() const
+	{
+		return DispatchFrame.GetValue();
+	}
+
+	// Game thread time of collision updates, reset every frame
+	void AddGameThreadCycles(int64 Cycles)
+	{
+		check(IsInGameThread());
+		GameThreadCycles += Cycles;
+	}
+
+	// Game thread only. False means collision update was deferred and will be run by the dispatcher later
+	bool CanStartCollisionUpdate(URuntimeMesh* Mesh)
+	{
+		check(IsInGameThread());
+		if (bRunningDeferredCollision || GameThreadCycles < GetBudgetCycles() || IsMeshVisible(Mesh))
+		{
+			return true;
+		}
+
+		DeferredCollisions.AddUnique(Mesh);
+		EnsureTickerRegistered();
+		return false;
+	}
+
+	// Game thread only
+	static bool IsMeshVisible(URuntimeMesh* Mesh)
+	{
+		bool bIsVisible = false;
+		Mesh->DoForAllLinkedComponents([&bIsVisible](URuntimeMeshComponent* MeshComponent)
+		{
+			bIsVisible |= MeshComponent->WasRecentlyRendered(0.5f) || IsNearView(MeshComponent);
+		});
+		return bIsVisible;
+	}
+
+	// Render times say nothing until a component was drawn, e.g. right after level load
+	static bool IsNearView(const URuntimeMeshComponent* MeshComponent)
+	{
+		const UWorld* World = MeshComponent->GetWorld();
+		if (World == nullptr)
+		{
+			return false;
+		}
+		const FBoxSphereBounds& Bounds = MeshComponent->Bounds;
+		const float VisibleDistance = CVarRuntimeMeshVisibleDistance.GetValueOnGameThread();
+		for (const FVector& ViewLocation : World->ViewLocationsRenderedLastFrame)
+		{
+			if (FVector::Dist(ViewLocation, Bounds.Origin) - Bounds.SphereRadius < VisibleDistance)
+			{
+				return true;
+			}
+		}
+
+		const APlayerController* Controller = World->GetFirstPlayerController();
+		const APlayerCameraManager* Camera = Controller != nullptr ? Controller->PlayerCameraManager : nullptr;
+		if (Camera == nullptr)
+		{
+			return false;
+		}
+		const FVector ToBounds = Bounds.Origin - Camera->GetCameraLocation();
+		const float Distance = ToBounds.Size();
+		if (Distance - Bounds.SphereRadius < VisibleDistance)
+		{
+			return true;
+		}
+		// View cone widened by the bounds sphere
+		const float Angle = FMath::Acos(FMath::Clamp(FVector::DotProduct(ToBounds / Distance, Camera->GetCameraRotation().Vector()), -1.f, 1.f));
+		return Angle - FMath::Asin(FMath::Min(Bounds.SphereRadius / Distance, 1.f)) <= FMath::DegreesToRadians(Camera->GetFOVAngle() * 0.5f);
+	}
+
+private:
+	void EnsureTickerRegistered()
+	{
+		if (!bTickerRegistered.AtomicSet(true))
+		{
+			FRuntimeMeshMisc::DoOnGameThread([this]()
+			{
+				FTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateRaw(this, &FRuntimeMeshUpdateDispatcher::Tick));
+			});
+		}
+	}
+
+	static int64 GetBudgetCycles()
+	{
+		return static_cast<int64>(CVarRuntimeMeshUpdateBudgetMs.GetValueOnAnyThread() / 1000.0 / FPlatformTime::GetSecondsPerCycle64());
+	}
+
+	static bool IsMoreUrgent(bool bVisibleA, float PriorityA, bool bVisibleB, float PriorityB)
+	{
+		return bVisibleA != bVisibleB ? bVisibleA : PriorityA > PriorityB;
+	}
+
+	bool Tick(float DeltaTime)
+	{
+		SCOPE_CYCLE_COUNTER(STAT_RuntimeMeshUpdateDispatch_Tick);
+
+		// New frame, new budget
+		GameThreadCycles = 0;
+		DispatchFrame.Increment();
+		DispatchStartCycles.Set(FPlatformTime::Cycles64());
+
+		TickDeferredCollisions();
+
+		TArray<FRuntimeMeshUpdateRequest> Requests;
+		FRuntimeMeshWeakRef MeshRef;
+		while (PendingMeshes.Dequeue(MeshRef))
+		{
+			FRuntimeMeshSharedRef Mesh = MeshRef.Pin();
+			if (Mesh)
+			{
+				Requests.Add({ MeshRef, Mesh->GetUpdatePriority(), IsMeshVisible(Mesh.Get()) });
+			}
+		}
+		if (Requests.Num() == 0)
+		{
+			return true;
+		}
+
+		Requests.Sort([](const FRuntimeMeshUpdateRequest& A, const FRuntimeMeshUpdateRequest& B)
+		{
+			return IsMoreUrgent(A.bIsVisible, A.Priority, B.bIsVisible, B.Priority);
+		});
 
-	FRuntimeMeshWeakRef Ref;
+		URuntimeMeshComponentEngineSubsystem* RMCSubsystem = GEngine->GetEngineSubsystem<URuntimeMeshComponentEngineSubsystem>();
+		check(RMCSubsystem);
 
-	FRuntimeMeshUpdateTask(const FRuntimeMeshWeakRef& InRef)
-		: Ref(InRef)
+		// Strided split, so every task works from the most urgent end of the list
+		const int32 NumTasks = FMath::Clamp(CVarRuntimeMeshUpdateTasks.GetValueOnGameThread(), 1, Requests.Num());
+		for (int32 TaskIdx = 0; TaskIdx < NumTasks; TaskIdx++)
+		{
+			TArray<FRuntimeMeshUpdateRequest> Batch;
+			Batch.Reserve(FMath::DivideAndRoundUp(Requests.Num(), NumTasks));
+			for (int32 Idx = TaskIdx; Idx < Requests.Num(); Idx += NumTasks)
+			{
+				Batch.Add(Requests[Idx]);
+			}
+			(new FAutoDeleteAsyncTask<FRuntimeMeshBatchUpdateTask>(MoveTemp(Batch), DispatchFrame.GetValue()))->StartBackgroundTask(RMCSubsystem->GetThreadPool());
+			INC_DWORD_STAT(STAT_RuntimeMeshUpdateDispatch_Tasks);
+		}
+		INC_DWORD_STAT_BY(STAT_RuntimeMeshUpdateDispatch_Meshes, Requests.Num());
+
+		return true;
+	}
+
+	void TickDeferredCollisions()
 	{
+		if (DeferredCollisions.Num() == 0)
+		{
+			return;
+		}
+
+		struct FCollisionRequest
+		{
+			URuntimeMesh* Mesh;
+			float Priority;
+			bool bIsVisible;
+		};
+		TArray<FCollisionRequest> Requests;
+		for (const TWeakObjectPtr<URuntimeMesh>& MeshPtr : DeferredCollisions)
+		{
+			if (URuntimeMesh* Mesh = MeshPtr.Get())
+			{
+				Requests.Add({ Mesh, Mesh->GetUpdatePriority(), IsMeshVisible(Mesh) });
+			}
+		}
+		DeferredCollisions.Reset();
+
+		Requests.Sort([](const FCollisionRequest& A, const FCollisionRequest& B)
+		{
+			return IsMoreUrgent(A.bIsVisible, A.Priority, B.bIsVisible, B.Priority);
+		});
+
+		// At least one update per frame, so nothing waits forever on a tiny budget
+		TGuardValue<bool> RunningGuard(bRunningDeferredCollision, true);
+		for (int32 Idx = 0; Idx < Requests.Num(); Idx++)
+		{
+			if (Idx > 0 && !Requests[Idx].bIsVisible && GameThreadCycles >= GetBudgetCycles())
+			{
+				DeferredCollisions.Add(Requests[Idx].Mesh);
+				continue;
+			}
+			Requests[Idx].Mesh->UpdateCollision(false);
+		}
+		INC_DWORD_STAT_BY(STAT_RuntimeMeshUpdateDispatch_DeferredCollisions, DeferredCollisions.Num());
 	}
 
-	void DoWork()
+	TQueue<FRuntimeMeshWeakRef, EQueueMode::Mpsc> PendingMeshes;
+	TArray<TWeakObjectPtr<URuntimeMesh>> DeferredCollisions;
+	FThreadSafeCounter64 DispatchFrame;
+	FThreadSafeCounter64 DispatchStartCycles;
+	int64 GameThreadCycles = 0;
+	FThreadSafeBool bTickerRegistered;
+	bool bRunningDeferredCollision = false;
+};
+
+void FRuntimeMeshBatchUpdateTask::DoWork()
+{
+	FRuntimeMeshUpdateDispatcher& Dispatcher = FRuntimeMeshUpdateDispatcher::Get();
+
+	for (int32 Idx = 0; Idx < Requests.Num(); Idx++)
 	{
-		FRuntimeMeshSharedRef PinnedRef = Ref.Pin();
+		// Out of budget - the rest keeps its queued flag and goes back to the dispatcher for next frame
+		if (Idx > 0 && !Dispatcher.CanStartMeshUpdate(Requests[Idx], Frame))
+		{
+			for (; Idx < Requests.Num(); Idx++)
+			{
+				Dispatcher.Enqueue(Requests[Idx].Mesh);
+			}
+			INC_DWORD_STAT(STAT_RuntimeMeshUpdateDispatch_BudgetExceeded);
+			break;
+		}
+
+		FRuntimeMeshSharedRef PinnedRef = Requests[Idx].Mesh.Pin();
 		if (PinnedRef)
 		{
 			if (PinnedRef->bQueuedForMeshUpdate.AtomicSet(false))
@@ -53,17 +367,158 @@ class FRuntimeMeshUpdateTask : public FNonAbandonableTask
 				PinnedRef->HandleUpdate();
 				//}
 			}
+		}
+	}
+}
 
+
+
+
+/*
+*	Cooked body setups shared between meshes with identical collision, keyed by hash of the collision content.
+*	Setups are owned by the meshes using them, so only weak references are kept here. Game thread only.
+*/
+class FRuntimeMeshSharedBodySetups
+{
+public:
+	static uint64 HashCollision(const FRuntimeMeshCollisionSettings& Settings, const FRuntimeMeshCollisionData* CollisionMesh, const TArray<FVector>& Vertices, const TArray<FTriIndices>& Triangles)
+	{
+		uint64 Hash = Settings.bUseComplexAsSimple ? 1 : 0;
+		const auto HashBytes = [&Hash](const void* Data, int64 Size)
+		{
+			Hash = CityHash64WithSeed(static_cast<const char*>(Data), Size, Hash);
+		};
+
+		for (const FRuntimeMeshCollisionConvexMesh& Convex : Settings.ConvexElements)
+		{
+			HashBytes(Convex.VertexBuffer.GetData(), Convex.VertexBuffer.Num() * sizeof(FVector));
+			HashBytes(&Convex.BoundingBox.Min, sizeof(FVector));
+			HashBytes(&Convex.BoundingBox.Max, sizeof(FVector));
 		}
+		for (const FRuntimeMeshCollisionBox& Box : Settings.Boxes)
+		{
+			HashBytes(&Box.Center, sizeof(FVector));
+			HashBytes(&Box.Rotation, sizeof(FRotator));
+			HashBytes(&Box.Extents, sizeof(FVector));
+		}
+		for (const FRuntimeMeshCollisionSphere& Sphere : Settings.Spheres)
+		{
+			HashBytes(&Sphere.Center, sizeof(FVector));
+			HashBytes(&Sphere.Radius, sizeof(float));
+		}
+		for (const FRuntimeMeshCollisionCapsule& Capsule : Settings.Capsules)
+		{
+			HashBytes(&Capsule.Center, sizeof(FVector));
+			HashBytes(&Capsule.Rotation, sizeof(FRotator));
+			HashBytes(&Capsule.Radius, sizeof(float));
+			HashBytes(&Capsule.Length, sizeof(float));
+		}
+
+		if (CollisionMesh != nullptr)
+		{
+			const uint8 Flags[] = { CollisionMesh->bDeformableMesh, CollisionMesh->bDisableActiveEdgePrecompute, CollisionMesh->bFastCook, CollisionMesh->bFlipNormals };
+			HashBytes(Flags, sizeof(Flags));
+			HashBytes(Vertices.GetData(), Vertices.Num() * sizeof(FVector));
+			HashBytes(Triangles.GetData(), Triangles.Num() * sizeof(FTriIndices));
+		}
+
+		// Zero is used as "no hash"
+		return Hash != 0 ? Hash : 1;
 	}
 
-	FORCEINLINE TStatId GetStatId() const
+	static UBodySetup* Find(uint64 Hash)
 	{
-		return TStatId();
-		// RETURN_QUICK_DECLARE_CYCLE_STAT(ExampleAsyncTask, STATGROUP_ThreadPoolAsyncTasks);
+		TWeakObjectPtr<UBodySetup>* Found = ReadySetups.Find(Hash);
+		if (Found == nullptr)
+		{
+			return nullptr;
+		}
+		if (!Found->IsValid())
+		{
+			ReadySetups.Remove(Hash);
+			return nullptr;
+		}
+		return Found->Get();
+	}
+
+	static void Register(uint64 Hash, UBodySetup* Setup)
+	{
+		ReadySetups.Add(Hash, Setup);
+	}
+
+	// Async cooks are registered only once they finish, so nobody picks up a setup without cooked data
+	static void AddPendingCook(UBodySetup* Setup, uint64 Hash)
+	{
+		PendingCooks.Add(Setup, Hash);
+	}
+
+	static uint64 TakePendingCook(UBodySetup* Setup)
+	{
+		uint64 Hash = 0;
+		PendingCooks.RemoveAndCopyValue(Setup, Hash);
+		return Hash;
 	}
+
+private:
+	static TMap<uint64, TWeakObjectPtr<UBodySetup>> ReadySetups;
+	static TMap<UBodySetup*, uint64> PendingCooks;
 };
 
+TMap<uint64, TWeakObjectPtr<UBodySetup>> FRuntimeMeshSharedBodySetups::ReadySetups;
+TMap<UBodySetup*, uint64> FRuntimeMeshSharedBodySetups::PendingCooks;
+
+#if WITH_PHYSX && PHYSICS_INTERFACE_PHYSX
+/*
+*	Triangle mesh collision cooked into a PhysX stream, which is what OnCollisionCooked hands out and FindPrecookedCollision takes back.
+*	The stream is the output of the very cook the body setup uses, so it needs no DDC and no second cook, and works in cooked builds.
+*/
+class FRuntimeMeshCollisionStream
+{
+public:
+	// Convex elements are left to the regular cook
+	static bool CanCapture(const FCookBodySetupInfo& CookInfo)
+	{
+		return CookInfo.bCookTriMesh && !CookInfo.bTriMeshError && CookInfo.NonMirroredConvexVertices.Num() == 0 && CookInfo.MirroredConvexVertices.Num() == 0;
+	}
+
+	// Touches no UObjects, safe on worker threads
+	static physx::PxTriangleMesh* Cook(const FCookBodySetupInfo& CookInfo, TArray<uint8>& OutStream)
+	{
+		IPhysXCookingModule* CookingModule = GetPhysXCookingModule();
+		IPhysXCooking* Cooking = CookingModule != nullptr ? CookingModule->GetPhysXCooking() : nullptr;
+		const FTriMeshCollisionData& Desc = CookInfo.TriangleMeshDesc;
+		if (Cooking == nullptr || !Cooking->CookTriMesh(FPlatformProperties::GetPhysicsFormat(), CookInfo.TriMeshCookFlags, Desc.Vertices, Desc.Indices, Desc.MaterialIndices, Desc.bFlipNormals, OutStream))
+		{
+			OutStream.Empty();
+			return nullptr;
+		}
+		return CreateTriMesh(OutStream);
+	}
+
+	// Streams of another PhysX version or platform are rejected by PhysX itself
+	static physx::PxTriangleMesh* CreateTriMesh(const TArray<uint8>& Stream)
+	{
+		if (Stream.Num() == 0 || GPhysXSDK == nullptr)
+		{
+			return nullptr;
+		}
+		physx::PxDefaultMemoryInputData Input(const_cast<uint8*>(Stream.GetData()), Stream.Num());
+		return GPhysXSDK->createTriangleMesh(Input);
+	}
+
+	// Body setup owns the mesh from here on
+	static void Apply(UBodySetup* Setup, physx::PxTriangleMesh* TriMesh)
+	{
+		const TArray<physx::PxConvexMesh*> NoConvexMeshes;
+		TArray<physx::PxTriangleMesh*> TriMeshes;
+		TriMeshes.Add(TriMesh);
+		Setup->FinishCreatingPhysicsMeshes_PhysX(NoConvexMeshes, NoConvexMeshes, TriMeshes);
+	}
+};
+#endif
+
+FRuntimeMeshFindPrecookedCollision URuntimeMesh::FindPrecookedCollision;
+FRuntimeMeshCollisionCooked URuntimeMesh::OnCollisionCooked;
 
 
 
@@ -75,6 +530,11 @@ URuntimeMesh::URuntimeMesh(const FObjectInitializer& ObjectInitializer)
 	: URuntimeMeshProviderTargetInterface(ObjectInitializer)
 	, bQueuedForMeshUpdate(false)
 	, bCollisionIsDirty(false)
+	, DirtyLODMask(0)
+	, UpdatePriority(0.f)
+	, BodySetupHash(0)
+	, RenderDataBytes(0)
+	, BodySetupBytes(0)
 	, MeshProviderPtr(nullptr)
 	, BodySetup(nullptr)
 	, GCAnchor(this)
@@ -169,6 +629,7 @@ void URuntimeMesh::Reset()
 	FScopeLock Lock(&SyncRoot);
 
 	BodySetup = nullptr;
+	BodySetupHash = 0;
 	CollisionSource.Empty();
 	AsyncBodySetupQueue.Empty();
 	PendingSourceInfo.Reset();
@@ -178,6 +639,14 @@ void URuntimeMesh::Reset()
 	MaterialSlots.Empty();
 	SlotNameLookup.Empty();
 	SectionsToUpdate.Empty();
+	DirtyLODMask = 0;
+	DirtySectionMeshes.Empty();
+
+	DEC_MEMORY_STAT_BY(STAT_RuntimeMeshMemory_RenderData, RenderDataBytes);
+	DEC_MEMORY_STAT_BY(STAT_RuntimeMeshMemory_BodySetups, BodySetupBytes);
+	SectionRenderBytes.Empty();
+	RenderDataBytes = 0;
+	BodySetupBytes = 0;
 
 	if (RenderProxy)
 	{
@@ -266,8 +735,31 @@ void URuntimeMesh::ConfigureLODs(const TArray<FRuntimeMeshLODProperties>& InLODs
 
 void URuntimeMesh::SetLODScreenSize(int32 LODIndex, float ScreenSize)
 {
-	RMC_LOG_VERBOSE("MarkLODDirty called: LOD:%d ScreenSize:%f", LODIndex, ScreenSize);
-	// TODO: Implement
+	RMC_LOG_VERBOSE("SetLODScreenSize called: LOD:%d ScreenSize:%f", LODIndex, ScreenSize);
+
+	TArray<FRuntimeMeshLODProperties> LODProperties;
+	{
+		FScopeLock Lock(&SyncRoot);
+		if (!LODs.IsValidIndex(LODIndex) || LODs[LODIndex].Properties.ScreenSize == ScreenSize)
+		{
+			return;
+		}
+		LODs[LODIndex].Properties.ScreenSize = ScreenSize;
+
+		LODProperties.SetNum(LODs.Num());
+		for (int32 Index = 0; Index < LODs.Num(); Index++)
+		{
+			LODProperties[Index] = LODs[Index].Properties;
+		}
+	}
+
+	// Only LOD properties go to the live proxy, like ConfigureLODs does - sections and their buffers stay, nothing is marked dirty.
+	// Scene proxies read screen sizes when they are created, so they are recreated.
+	if (RenderProxy.IsValid())
+	{
+		RenderProxy->InitializeLODs_GameThread(LODProperties);
+		RecreateAllComponentSceneProxies();
+	}
 }
 
 void URuntimeMesh::MarkLODDirty(int32 LODIndex)
@@ -279,7 +771,7 @@ void URuntimeMesh::MarkLODDirty(int32 LODIndex)
 	check(LODs.IsValidIndex(LODIndex));
 
 	// Flag for update
-	SectionsToUpdate.FindOrAdd(LODIndex).FindOrAdd(INDEX_NONE) = ESectionUpdateType::Mesh;
+	DirtyLODMask |= 1u << LODIndex;
 
 	QueueForMeshUpdate();
 }
@@ -291,10 +783,7 @@ void URuntimeMesh::MarkAllLODsDirty()
 	FScopeLock Lock(&SyncRoot);
 
 	// Flag for update
-	for (int32 LODIdx = 0; LODIdx < LODs.Num(); LODIdx++)
-	{
-		SectionsToUpdate.FindOrAdd(LODIdx).FindOrAdd(INDEX_NONE) = ESectionUpdateType::Mesh;
-	}
+	DirtyLODMask |= (1u << LODs.Num()) - 1;
 
 	QueueForMeshUpdate();
 }
@@ -311,8 +800,9 @@ void URuntimeMesh::CreateSection(int32 LODIndex, int32 SectionId, const FRuntime
 
 	LODs[LODIndex].Sections.FindOrAdd(SectionId) = SectionProperties;
 
-	// Flag for update
-	SectionsToUpdate.FindOrAdd(LODIndex).FindOrAdd(SectionId) = ESectionUpdateType::AllData;
+	// Flag for update, mesh part goes through the dirty bits
+	SectionsToUpdate.FindOrAdd(LODIndex).FindOrAdd(SectionId) = ESectionUpdateType::Properties;
+	SetSectionMeshDirty_Unsynced(LODIndex, SectionId, true);
 	QueueForMeshUpdate();
 }
 
@@ -365,10 +855,15 @@ void URuntimeMesh::MarkSectionDirty(int32 LODIndex, int32 SectionId)
 
 	FScopeLock Lock(&SyncRoot);
 
-	// Flag for update
-	ESectionUpdateType& UpdateType = SectionsToUpdate.FindOrAdd(LODIndex).FindOrAdd(SectionId);
-	UpdateType |= ESectionUpdateType::Mesh;
-	UpdateType = (UpdateType & ~ESectionUpdateType::ClearOrRemove);
+	// Flag for update, a pending clear is cancelled by new mesh
+	if (TMap<int32, ESectionUpdateType>* LODUpdates = SectionsToUpdate.Find(LODIndex))
+	{
+		if (ESectionUpdateType* UpdateType = LODUpdates->Find(SectionId))
+		{
+			*UpdateType = (*UpdateType & ~ESectionUpdateType::ClearOrRemove);
+		}
+	}
+	SetSectionMeshDirty_Unsynced(LODIndex, SectionId, true);
 	QueueForMeshUpdate();
 }
 
@@ -385,6 +880,7 @@ void URuntimeMesh::ClearSection(int32 LODIndex, int32 SectionId)
 	{
 		ESectionUpdateType& UpdateType = SectionsToUpdate.FindOrAdd(LODIndex).FindOrAdd(SectionId);
 		UpdateType = ESectionUpdateType::Clear;
+		SetSectionMeshDirty_Unsynced(LODIndex, SectionId, false);
 		QueueForMeshUpdate();
 	}
 }
@@ -402,12 +898,46 @@ void URuntimeMesh::RemoveSection(int32 LODIndex, int32 SectionId)
 		if (RenderProxy.IsValid())
 		{
 			SectionsToUpdate.FindOrAdd(LODIndex).FindOrAdd(SectionId) = ESectionUpdateType::Remove;
+			SetSectionMeshDirty_Unsynced(LODIndex, SectionId, false);
 			QueueForMeshUpdate();
 			RecreateAllComponentSceneProxies();
 		}
 	}
 }
 
+void URuntimeMesh::SetSectionMeshDirty_Unsynced(int32 LODIndex, int32 SectionId, bool bIsDirty)
+{
+	if (DirtySectionMeshes.Num() <= LODIndex)
+	{
+		if (!bIsDirty)
+		{
+			return;
+		}
+		DirtySectionMeshes.SetNum(LODIndex + 1);
+	}
+
+	TBitArray<>& LODBits = DirtySectionMeshes[LODIndex];
+	if (LODBits.Num() <= SectionId)
+	{
+		if (!bIsDirty)
+		{
+			return;
+		}
+		LODBits.Add(false, SectionId + 1 - LODBits.Num());
+	}
+	LODBits[SectionId] = bIsDirty;
+}
+
+void URuntimeMesh::SetUpdatePriority(float InPriority)
+{
+	UpdatePriority = InPriority;
+}
+
+float URuntimeMesh::GetUpdatePriority() const
+{
+	return UpdatePriority;
+}
+
 void URuntimeMesh::MarkCollisionDirty()
 {
 	RMC_LOG_VERBOSE("MarkCollisionDirty called.");
@@ -502,6 +1032,7 @@ UMaterialInterface* URuntimeMesh::GetMaterial(int32 SlotIndex)
 void URuntimeMesh::BeginDestroy()
 {
 	RMC_LOG_VERBOSE("BeginDestroy called.");
+	// Releases render data and body setup bytes. RF_BeginDestroyed is set by now, so updates still in flight count nothing more.
 	Reset();
 	GCAnchor.BeginDestroy();
 	Super::BeginDestroy();
@@ -634,7 +1165,7 @@ void URuntimeMesh::QueueForMeshUpdate()
 				{
 					if (Mesh->MeshProviderPtr->IsThreadSafe())
 					{
-						(new FAutoDeleteAsyncTask<FRuntimeMeshUpdateTask>(Mesh->GetMeshReference()))->StartBackgroundTask(Mesh->GetEngineSubsystem()->GetThreadPool());
+						FRuntimeMeshUpdateDispatcher::Get().Enqueue(Mesh->GetMeshReference());
 					}
 					else
 					{
@@ -752,16 +1283,42 @@ void URuntimeMesh::HandleUpdate()
 						if (EnumHasAllFlags(UpdateType, ESectionUpdateType::Remove))
 						{
 							RenderProxyRef->RemoveSection_GameThread(LODId, SectionId);
+							SetSectionRenderBytes(LODId, SectionId, 0);
 						}
 						else if (EnumHasAllFlags(UpdateType, ESectionUpdateType::Clear))
 						{
 							RenderProxyRef->ClearSection_GameThread(LODId, SectionId);
+							SetSectionRenderBytes(LODId, SectionId, 0);
 						}
 					}
 				}
 			}
 
 			SectionsToUpdate.Reset();
+
+			// Whole LODs and single section meshes marked dirty
+			for (int32 LODId = 0; LODId < LODs.Num(); LODId++)
+			{
+				if (DirtyLODMask & (1u << LODId))
+				{
+					SectionsToGetMesh.FindOrAdd(LODId).Add(INDEX_NONE);
+				}
+				else if (DirtySectionMeshes.IsValidIndex(LODId))
+				{
+					for (TConstSetBitIterator<> It(DirtySectionMeshes[LODId]); It; ++It)
+					{
+						if (LODs[LODId].Sections.Contains(It.GetIndex()))
+						{
+							SectionsToGetMesh.FindOrAdd(LODId).Add(It.GetIndex());
+						}
+					}
+				}
+			}
+			DirtyLODMask = 0;
+			for (TBitArray<>& LODBits : DirtySectionMeshes)
+			{
+				LODBits.Init(false, LODBits.Num());
+			}
 		}
 
 		for (const auto& LODEntry : SectionsToGetMesh)
@@ -831,7 +1388,7 @@ void URuntimeMesh::HandleFullLODUpdate(const FRuntimeMeshProxyPtr& RenderProxyRe
 			LOD.Sections.FindOrAdd(Entry.Key) = Section.Properties;
 
 			RenderProxyRef->CreateOrUpdateSection_GameThread(LODId, Entry.Key, Section.Properties, true);
-
+			SetSectionRenderBytes(LODId, Entry.Key, GetRenderableMeshBytes(Section.MeshData));
 
 			TSharedPtr<FRuntimeMeshSectionUpdateData> UpdateData = MakeShared<FRuntimeMeshSectionUpdateData>(MoveTemp(Section.MeshData));
 
@@ -849,6 +1406,7 @@ void URuntimeMesh::HandleFullLODUpdate(const FRuntimeMeshProxyPtr& RenderProxyRe
 		{
 			// Clear existing section
 			RenderProxyRef->ClearSection_GameThread(LODId, Entry.Key);
+			SetSectionRenderBytes(LODId, Entry.Key, 0);
 			bRequiresProxyRecreate = true;
 		}
 
@@ -861,6 +1419,7 @@ void URuntimeMesh::HandleFullLODUpdate(const FRuntimeMeshProxyPtr& RenderProxyRe
 	{
 		LODs[LODId].Sections.Remove(Entry);
 		RenderProxyRef->RemoveSection_GameThread(LODId, Entry);
+		SetSectionRenderBytes(LODId, Entry, 0);
 		bRequiresProxyRecreate = true;
 	}
 }
@@ -879,6 +1438,8 @@ void URuntimeMesh::HandleSingleSectionUpdate(const FRuntimeMeshProxyPtr& RenderP
 	
 	if (bResult && MeshData.HasValidMeshData())
 	{
+		SetSectionRenderBytes(LODId, SectionId, GetRenderableMeshBytes(MeshData));
+
 		// Update section
 		TSharedPtr<FRuntimeMeshSectionUpdateData> UpdateData = MakeShared<FRuntimeMeshSectionUpdateData>(MoveTemp(MeshData));
 
@@ -896,6 +1457,7 @@ void URuntimeMesh::HandleSingleSectionUpdate(const FRuntimeMeshProxyPtr& RenderP
 	{
 		// Clear section
 		RenderProxyRef->ClearSection_GameThread(LODId, SectionId);
+		SetSectionRenderBytes(LODId, SectionId, 0);
 		bRequiresProxyRecreate |= Properties.UpdateFrequency == ERuntimeMeshUpdateFrequency::Infrequent;
 		bRequiresProxyRecreate = true;
 	}
@@ -903,6 +1465,54 @@ void URuntimeMesh::HandleSingleSectionUpdate(const FRuntimeMeshProxyPtr& RenderP
 
 
 
+void URuntimeMesh::SetSectionRenderBytes(int32 LODId, int32 SectionId, int64 Bytes)
+{
+	FScopeLock Lock(&SyncRoot);
+
+	// Updates finishing after BeginDestroy released the counters must not add bytes nobody releases again
+	if (HasAnyFlags(RF_BeginDestroyed))
+	{
+		Bytes = 0;
+	}
+
+	const FIntPoint Key(LODId, SectionId);
+	const int64 OldBytes = SectionRenderBytes.FindRef(Key);
+	DEC_MEMORY_STAT_BY(STAT_RuntimeMeshMemory_RenderData, OldBytes);
+	INC_MEMORY_STAT_BY(STAT_RuntimeMeshMemory_RenderData, Bytes);
+	RenderDataBytes += Bytes - OldBytes;
+
+	if (Bytes > 0)
+	{
+		SectionRenderBytes.Add(Key, Bytes);
+	}
+	else
+	{
+		SectionRenderBytes.Remove(Key);
+	}
+}
+
+int64 URuntimeMesh::GetRenderDataBytes() const
+{
+	FScopeLock Lock(&SyncRoot);
+	return RenderDataBytes;
+}
+
+// Shared setups are counted only by the mesh that cooked them
+void URuntimeMesh::UpdateBodySetupBytes()
+{
+	check(IsInGameThread());
+
+	const int64 Bytes = (BodySetup != nullptr && BodySetup->GetOuter() == this && !HasAnyFlags(RF_BeginDestroyed)) ? BodySetup->GetResourceSizeBytes(EResourceSizeMode::EstimatedTotal) : 0;
+	DEC_MEMORY_STAT_BY(STAT_RuntimeMeshMemory_BodySetups, BodySetupBytes);
+	INC_MEMORY_STAT_BY(STAT_RuntimeMeshMemory_BodySetups, Bytes);
+	BodySetupBytes = Bytes;
+}
+
+int64 URuntimeMesh::GetBodySetupBytes() const
+{
+	return BodySetupBytes;
+}
+
 URuntimeMeshComponentEngineSubsystem* URuntimeMesh::GetEngineSubsystem()
 {
 	URuntimeMeshComponentEngineSubsystem* RMCSubsystem = GEngine->GetEngineSubsystem<URuntimeMeshComponentEngineSubsystem>();
@@ -912,6 +1522,7 @@ URuntimeMeshComponentEngineSubsystem* URuntimeMesh::GetEngineSubsystem()
 
 UBodySetup* URuntimeMesh::CreateNewBodySetup()
 {
+	// Outer must stay this mesh even for shared setups - cooking reads the tri mesh from it
 	UBodySetup* NewBodySetup = NewObject<UBodySetup>(this, NAME_None, (IsTemplate() ? RF_Public : RF_NoFlags));
 	NewBodySetup->BodySetupGuid = FGuid::NewGuid();
 
@@ -924,13 +1535,53 @@ void URuntimeMesh::UpdateCollision(bool bForceCookNow)
 
 	check(IsInGameThread());
 
+	FRuntimeMeshUpdateDispatcher& Dispatcher = FRuntimeMeshUpdateDispatcher::Get();
+	if (!bForceCookNow && !Dispatcher.CanStartCollisionUpdate(this))
+	{
+		return;
+	}
+	const uint64 StartCycles = FPlatformTime::Cycles64();
+	ON_SCOPE_EXIT
+	{
+		Dispatcher.AddGameThreadCycles(FPlatformTime::Cycles64() - StartCycles);
+	};
+
 	FReadScopeLock Lock(MeshProviderLock);
 	if (MeshProviderPtr)
 	{
 		FRuntimeMeshCollisionSettings CollisionSettings = MeshProviderPtr->GetCollisionSettings();
 
-		UWorld* World = GetWorld();
-		const bool bShouldCookAsync = !bForceCookNow && World && World->IsGameWorld() && CollisionSettings.bUseAsyncCooking;
+		// Same collision as already cooked for this or any other mesh means no cooking, and no physics/navigation refresh if it's ours
+		FRuntimeMeshCollisionData CollisionMesh;
+		const bool bHasCollisionMesh = MeshProviderPtr->HasCollisionMesh() && MeshProviderPtr->GetCollisionMesh(CollisionMesh);
+		const TArray<FVector> CollisionVertices = bHasCollisionMesh ? CollisionMesh.Vertices.TakeContents() : TArray<FVector>();
+		const TArray<FTriIndices> CollisionTriangles = bHasCollisionMesh ? CollisionMesh.Triangles.TakeContents() : TArray<FTriIndices>();
+		const uint64 CollisionHash = IsTemplate() ? 0 : FRuntimeMeshSharedBodySetups::HashCollision(CollisionSettings, bHasCollisionMesh ? &CollisionMesh : nullptr, CollisionVertices, CollisionTriangles);
+
+		if (CollisionHash != 0 && BodySetup != nullptr && BodySetupHash == CollisionHash && AsyncBodySetupQueue.Num() == 0)
+		{
+			INC_DWORD_STAT(STAT_RuntimeMeshSharedCollision_Skipped);
+			return;
+		}
+
+		if (UBodySetup* SharedBodySetup = CollisionHash != 0 ? FRuntimeMeshSharedBodySetups::Find(CollisionHash) : nullptr)
+		{
+#if ENGINE_MAJOR_VERSION >= 4 && ENGINE_MINOR_VERSION >= 21
+			for (const auto& OldBody : AsyncBodySetupQueue)
+			{
+				OldBody.BodySetup->AbortPhysicsMeshAsyncCreation();
+			}
+#endif
+			AsyncBodySetupQueue.Empty();
+
+			BodySetup = SharedBodySetup;
+			BodySetupHash = CollisionHash;
+			CollisionSource = MoveTemp(CollisionMesh.CollisionSources);
+			INC_DWORD_STAT(STAT_RuntimeMeshSharedCollision_Reused);
+
+			FinalizeNewCookedData();
+			return;
+		}
 
 		const auto& SetupCollisionConfiguration = [&](UBodySetup* Setup)
 		{
@@ -983,6 +1634,44 @@ void URuntimeMesh::UpdateCollision(bool bForceCookNow)
 			}
 		};
 
+		// Cooked data stored by the game (e.g. with the mesh cache) is loaded as is, no cooking at all
+#if WITH_PHYSX && PHYSICS_INTERFACE_PHYSX
+		TArray<uint8> PrecookedData;
+		physx::PxTriangleMesh* PrecookedMesh = nullptr;
+		if (CollisionHash != 0 && FindPrecookedCollision.IsBound() && FindPrecookedCollision.Execute(MeshProviderPtr, CollisionHash, PrecookedData))
+		{
+			PrecookedMesh = FRuntimeMeshCollisionStream::CreateTriMesh(PrecookedData);
+		}
+		if (PrecookedMesh != nullptr)
+		{
+#if ENGINE_MAJOR_VERSION >= 4 && ENGINE_MINOR_VERSION >= 21
+			for (const auto& OldBody : AsyncBodySetupQueue)
+			{
+				OldBody.BodySetup->AbortPhysicsMeshAsyncCreation();
+			}
+#endif
+			AsyncBodySetupQueue.Empty();
+
+			UBodySetup* NewBodySetup = CreateNewBodySetup();
+			SetupCollisionConfiguration(NewBodySetup);
+			FRuntimeMeshCollisionStream::Apply(NewBodySetup, PrecookedMesh);
+
+			CollisionSource = MoveTemp(CollisionMesh.CollisionSources);
+			BodySetup = NewBodySetup;
+			BodySetupHash = CollisionHash;
+			FRuntimeMeshSharedBodySetups::Register(CollisionHash, NewBodySetup);
+			INC_DWORD_STAT(STAT_RuntimeMeshSharedCollision_Precooked);
+
+			FinalizeNewCookedData();
+			return;
+		}
+#endif
+
+		UWorld* World = GetWorld();
+		const bool bShouldCookAsync = !bForceCookNow && World && World->IsGameWorld() && CollisionSettings.bUseAsyncCooking;
+
+		// Cooking it ourselves is only worth it when someone keeps the cooked stream
+		const bool bCaptureCook = CollisionHash != 0 && OnCollisionCooked.IsBound();
 
 		if (bShouldCookAsync)
 		{
@@ -1000,8 +1689,15 @@ void URuntimeMesh::UpdateCollision(bool bForceCookNow)
 			// Create pending source info while the mesh updates
 			PendingSourceInfo = MakeUnique<TArray<FRuntimeMeshCollisionSourceSectionInfo>>();
 
-			NewBodySetup->CreatePhysicsMeshesAsync(
-				FOnAsyncPhysicsCookFinished::CreateUObject(this, &URuntimeMesh::FinishPhysicsAsyncCook, NewBodySetup));
+			if (CollisionHash != 0)
+			{
+				FRuntimeMeshSharedBodySetups::AddPendingCook(NewBodySetup, CollisionHash);
+			}
+			if (!bCaptureCook || !CookCapturedCollisionAsync(NewBodySetup))
+			{
+				NewBodySetup->CreatePhysicsMeshesAsync(
+					FOnAsyncPhysicsCookFinished::CreateUObject(this, &URuntimeMesh::FinishPhysicsAsyncCook, NewBodySetup));
+			}
 
 			// Copy source info and reset pending
 			AsyncBodySetupQueue.Add(FRuntimeMeshAsyncBodySetupData(NewBodySetup, MoveTemp(*PendingSourceInfo.Get())));
@@ -1024,13 +1720,23 @@ void URuntimeMesh::UpdateCollision(bool bForceCookNow)
 			PendingSourceInfo = MakeUnique<TArray<FRuntimeMeshCollisionSourceSectionInfo>>();
 
 			NewBodySetup->InvalidatePhysicsData();
-			NewBodySetup->CreatePhysicsMeshes();
+			TArray<uint8> CookedData;
+			if (!bCaptureCook || !CookCapturedCollision(NewBodySetup, CookedData))
+			{
+				NewBodySetup->CreatePhysicsMeshes();
+			}
 
 			// Copy source info and reset pending
 			CollisionSource = MoveTemp(*PendingSourceInfo.Get());
 			PendingSourceInfo.Reset();
 
 			BodySetup = NewBodySetup;
+			BodySetupHash = CollisionHash;
+			if (CollisionHash != 0)
+			{
+				FRuntimeMeshSharedBodySetups::Register(CollisionHash, NewBodySetup);
+				BroadcastCookedCollision(CookedData, CollisionHash, MeshProviderPtr);
+			}
 			FinalizeNewCookedData();
 		}
 	}
@@ -1042,6 +1748,8 @@ void URuntimeMesh::FinishPhysicsAsyncCook(bool bSuccess, UBodySetup* FinishedBod
 
 	check(IsInGameThread());
 
+	const uint64 FinishedHash = FRuntimeMeshSharedBodySetups::TakePendingCook(FinishedBodySetup);
+
 	const auto& SearchPredicate = [&](const FRuntimeMeshAsyncBodySetupData& Entry)
 	{
 		return Entry.BodySetup == FinishedBodySetup;
@@ -1054,6 +1762,11 @@ void URuntimeMesh::FinishPhysicsAsyncCook(bool bSuccess, UBodySetup* FinishedBod
 		{
 			// The new body was found in the array meaning it's newer so use it
 			BodySetup = FinishedBodySetup;
+			BodySetupHash = FinishedHash;
+			if (FinishedHash != 0)
+			{
+				FRuntimeMeshSharedBodySetups::Register(FinishedHash, FinishedBodySetup);
+			}
 			CollisionSource = MoveTemp(AsyncBodySetupQueue[FoundIdx].CollisionSources);
 
 			// Shift down all remaining body setups, removing any old setups
@@ -1073,12 +1786,109 @@ void URuntimeMesh::FinishPhysicsAsyncCook(bool bSuccess, UBodySetup* FinishedBod
 	}
 }
 
+// Sync version, for editor worlds and forced cooks. Returns false if the setup has to be cooked the regular way.
+bool URuntimeMesh::CookCapturedCollision(UBodySetup* NewBodySetup, TArray<uint8>& OutCookedData)
+{
+#if WITH_PHYSX && PHYSICS_INTERFACE_PHYSX
+	FCookBodySetupInfo CookInfo;
+	NewBodySetup->GetCookInfo(CookInfo, NewBodySetup->GetRuntimeOnlyCookOptimizationFlags());
+	if (!FRuntimeMeshCollisionStream::CanCapture(CookInfo))
+	{
+		return false;
+	}
+
+	physx::PxTriangleMesh* TriMesh = FRuntimeMeshCollisionStream::Cook(CookInfo, OutCookedData);
+	if (TriMesh == nullptr)
+	{
+		return false;
+	}
+	FRuntimeMeshCollisionStream::Apply(NewBodySetup, TriMesh);
+	return true;
+#else
+	return false;
+#endif
+}
+
+// Same as CreatePhysicsMeshesAsync, but the cooked stream is kept and broadcast once the setup is taken into use
+bool URuntimeMesh::CookCapturedCollisionAsync(UBodySetup* NewBodySetup)
+{
+#if WITH_PHYSX && PHYSICS_INTERFACE_PHYSX
+	// Reads the collision mesh from us, so it runs here while pending source info is collected
+	FCookBodySetupInfo CookInfo;
+	NewBodySetup->GetCookInfo(CookInfo, NewBodySetup->GetRuntimeOnlyCookOptimizationFlags());
+	if (!FRuntimeMeshCollisionStream::CanCapture(CookInfo))
+	{
+		return false;
+	}
+
+	URuntimeMeshComponentEngineSubsystem* RMCSubsystem = GEngine->GetEngineSubsystem<URuntimeMeshComponentEngineSubsystem>();
+	check(RMCSubsystem);
+
+	TWeakObjectPtr<URuntimeMesh> WeakThis(this);
+	TWeakObjectPtr<UBodySetup> WeakBodySetup(NewBodySetup);
+	AsyncPool(*RMCSubsystem->GetThreadPool(), [WeakThis, WeakBodySetup, CookInfo = MoveTemp(CookInfo)]()
+	{
+		TArray<uint8> CookedData;
+		physx::PxTriangleMesh* TriMesh = FRuntimeMeshCollisionStream::Cook(CookInfo, CookedData);
+
+		AsyncTask(ENamedThreads::GameThread, [WeakThis, WeakBodySetup, TriMesh, CookedData = MoveTemp(CookedData)]()
+		{
+			URuntimeMesh* Mesh = WeakThis.Get();
+			UBodySetup* FinishedBodySetup = WeakBodySetup.Get();
+			const bool bQueued = Mesh != nullptr && FinishedBodySetup != nullptr && Mesh->AsyncBodySetupQueue.ContainsByPredicate([&](const FRuntimeMeshAsyncBodySetupData& Entry)
+			{
+				return Entry.BodySetup == FinishedBodySetup;
+			});
+
+			// Superseded or aborted while cooking, nobody is going to own the mesh
+			if (!bQueued)
+			{
+				if (TriMesh != nullptr)
+				{
+					TriMesh->release();
+				}
+				if (Mesh != nullptr && FinishedBodySetup != nullptr)
+				{
+					Mesh->FinishPhysicsAsyncCook(false, FinishedBodySetup);
+				}
+				return;
+			}
+
+			if (TriMesh != nullptr)
+			{
+				FRuntimeMeshCollisionStream::Apply(FinishedBodySetup, TriMesh);
+			}
+			Mesh->FinishPhysicsAsyncCook(TriMesh != nullptr, FinishedBodySetup);
+
+			if (Mesh->BodySetup == FinishedBodySetup && Mesh->BodySetupHash != 0)
+			{
+				FReadScopeLock Lock(Mesh->MeshProviderLock);
+				Mesh->BroadcastCookedCollision(CookedData, Mesh->BodySetupHash, Mesh->MeshProviderPtr);
+			}
+		});
+	});
+	return true;
+#else
+	return false;
+#endif
+}
+
+void URuntimeMesh::BroadcastCookedCollision(const TArray<uint8>& CookedData, uint64 CollisionHash, URuntimeMeshProvider* Provider)
+{
+	if (CookedData.Num() > 0 && OnCollisionCooked.IsBound())
+	{
+		OnCollisionCooked.Broadcast(Provider, CollisionHash, CookedData);
+	}
+}
+
 void URuntimeMesh::FinalizeNewCookedData()
 {
 	SCOPE_CYCLE_COUNTER(STAT_RuntimeMesh_FinalizeCollisionCookedData);
 
 	check(IsInGameThread());
 
+	UpdateBodySetupBytes();
+
 	// Alert all linked components so they can update their physics state.
 	DoForAllLinkedComponents([](URuntimeMeshComponent* Mesh)
 		{
@@ -75,8 +75,11 @@ void URuntimeMeshComponent::NewCollisionMeshReceived()
 	// First recreate the physics state
 	RecreatePhysicsState();
 	
- 	// Now update the navigation.
-	FNavigationSystem::UpdateComponentData(*this);
+ 	// Now update the navigation. Components that don't affect it (houses use a separate collider) skip the octree update
+	if (CanEverAffectNavigation())
+	{
+		FNavigationSystem::UpdateComponentData(*this);
+	}
 }
 
 void URuntimeMeshComponent::NewBoundsReceived()